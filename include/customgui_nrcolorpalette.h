@@ -3,6 +3,7 @@
 
 #pragma once
 #include <c4d.h>
+#include <c4d_apibridge.h>
 #include "res/description/Hnrtoolbox.h"
 
 enum
@@ -106,17 +107,63 @@ struct SwatchFolder : SwatchBase
 
 class ColorPaletteData : public iCustomDataType<ColorPaletteData>
 {
+  // Position of a folder or swatch in the #folders array. The swatch
+  // is NOTOK for folders.
+  struct Position
+  {
+    Int32 folder, swatch;
+  };
+
+  typedef c4d_apibridge::HashMap<Int32, Position> IdIndex;
+  typedef c4d_apibridge::HashMap<String, Position> NameIndex;
+
   Int32 next_idx = 0;
+
+  // Indexes for Find(), kept up to date by all members that modify the
+  // #folders. If building the indexes failed, Find() falls back to a
+  // linear search.
+  IdIndex id_index;
+  NameIndex name_index;
+  Bool index_valid = false;
+
+  inline SwatchBase const* GetAt(Position const& pos) const
+  {
+    SwatchFolder const& folder = this->folders[pos.folder];
+    if (pos.swatch == NOTOK) return &folder;
+    return &folder.swatches[pos.swatch];
+  }
+
+  // Adds a folder or swatch to the indexes. Swatch names are only
+  // added if not already present, as Find() returns the first match.
+  inline Bool AddToIndex(SwatchBase const& item, Position const& pos)
+  {
+    maxon::Bool created = false;
+    auto id_entry = this->id_index.FindOrCreateEntry(item.index, created);
+    if (!id_entry) return false;
+    id_entry->GetValue() = pos;
+    if (pos.swatch != NOTOK) {
+      auto entry = this->name_index.FindOrCreateEntry(item.GetName(), created);
+      if (!entry) return false;
+      if (created) entry->GetValue() = pos;
+    }
+    return true;
+  }
+
 public:
   Bool show_chooser = true;
-  maxon::BaseArray<SwatchFolder> folders;
+  maxon::BaseArray<SwatchFolder> folders;  // Call RebuildIndex() after direct modifications
 
-  ColorPaletteData() { (void) folders.Append({this->GetNextIndex(), "<root>"}); }
+  ColorPaletteData()
+  {
+    (void) folders.Append({this->GetNextIndex(), "<root>"});
+    this->RebuildIndex();
+  }
 
   ColorPaletteData(ColorPaletteData const& that)
     : next_idx(that.next_idx), show_chooser(that.show_chooser)
   {
     (void) folders.CopyFrom(that.folders);
+    this->RebuildIndex();
   }
 
   NR_OPERATOR_COPY_ASSIGNMENT(ColorPaletteData);
@@ -127,10 +174,27 @@ public:
 
   inline Int32 GetNextIndex() { return this->next_idx++; }
 
+  inline void RebuildIndex()
+  {
+    this->id_index = IdIndex();
+    this->name_index = NameIndex();
+    this->index_valid = true;
+    for (Int32 i = 0; i < (Int32) this->folders.GetCount(); ++i) {
+      SwatchFolder const& folder = this->folders[i];
+      this->index_valid = this->index_valid && this->AddToIndex(folder, {i, NOTOK});
+      for (Int32 j = 0; j < (Int32) folder.swatches.GetCount(); ++j)
+        this->index_valid = this->index_valid && this->AddToIndex(folder.swatches[j], {i, j});
+    }
+  }
+
   inline SwatchBase* Find(Int32 id) { return const_cast<SwatchBase*>(NR_MAKE_CONST(this)->Find(id)); }
 
   inline SwatchBase const* Find(Int32 id) const
   {
+    if (this->index_valid) {
+      auto entry = this->id_index.FindEntry(id);
+      return entry ? this->GetAt(entry->GetValue()) : nullptr;
+    }
     for (auto& folder : this->folders) {
       if (folder.index == id) return &folder;
       for (auto& swatch : folder.swatches) {
@@ -144,6 +208,10 @@ public:
 
   inline Swatch const* Find(String const& name) const
   {
+    if (this->index_valid) {
+      auto entry = this->name_index.FindEntry(name);
+      return entry ? static_cast<Swatch const*>(this->GetAt(entry->GetValue())) : nullptr;
+    }
     for (auto& folder : this->folders) {
       for (auto& swatch : folder.swatches) {
         if (swatch.GetName() == name) return &swatch;
@@ -173,6 +241,9 @@ public:
     iferr (SwatchFolder& folder =
            this->folders.Append(SwatchFolder{this->GetNextIndex(), name}))
       return nullptr;
+    Position const pos = {(Int32) this->folders.GetCount() - 1, NOTOK};
+    if (this->index_valid && !this->AddToIndex(folder, pos))
+      this->RebuildIndex();
     return &folder;
   }
 
@@ -191,9 +262,27 @@ public:
       return nullptr;
     res.index = this->GetNextIndex();
     res.color = color;
+
+    // Appending to the last folder does not move other swatches, and
+    // no swatch with the same name can follow the new one.
+    Int32 const folder_idx = (Int32) (folder - this->folders.GetFirst());
+    Int32 const swatch_idx = (Int32) folder->swatches.GetCount() - 1;
+    Bool const appended = index == NOTOK || index == swatch_idx;
+    if (appended && folder_idx == (Int32) this->folders.GetCount() - 1 && this->index_valid) {
+      if (!this->AddToIndex(res, {folder_idx, swatch_idx}))
+        this->RebuildIndex();
+    }
+    else this->RebuildIndex();
     return &res;
   }
 
+  inline void RenameSwatch(Swatch* swatch, String const& name)
+  {
+    if (!swatch) return;
+    swatch->name = name;
+    this->RebuildIndex();
+  }
+
   inline void SelectAll(Bool state=true)
   {
     for (auto& folder : this->folders) {
@@ -235,6 +324,7 @@ public:
       }
       return folder.swatches.GetCount() > 0;
     });
+    this->RebuildIndex();
   }
 
   inline void FillPopupContainer(BaseContainer& popup)
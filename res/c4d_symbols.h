@@ -228,6 +228,15 @@ enum
   IDS_AUTOCONNECT_HELP,
   IDS_AUTOCONNECT_OBJECT,
 
+  // WebP
+  // ----
+
+  IDS_WEBP_DLG_OPTIONS,
+  IDS_WEBP_CHK_LOSSLESS,
+  IDS_WEBP_EDT_QUALITY,
+  IDS_WEBP_EDT_METHOD,
+  IDS_WEBP_CHK_MULTITHREAD,
+
 };
 
 #endif // _C4D_SYMBOLS_H_
@@ -13,7 +13,7 @@
         CSVNODE_COLCOUNT_TOTAL,     // LONG   [out]
         CSVNODE_COLCOUNT,           // LONG   [out]
         CSVNODE_ROWCOUNT,           // LONG   [out]
-        CSVNODE_DYNPORT_START,      // String [out, dynamic]
+        CSVNODE_DYNPORT_START,      // String/Real/LONG [out, dynamic]
 
         CSVNODE_DELIMITER_COMMA = 44,
         CSVNODE_DELIMITER_SEMICOLON = 59,
@@ -22,6 +22,7 @@
         // Other attributes
         CSVNODE_FORCEOUTPORTS = 20000,  // BOOL
         CSVNODE_FORCEOUTPORTS_COUNT,    // LONG    
+        CSVNODE_TYPEDPORTS,             // BOOL
     };
 
 #endif /* Gvcsv */
@@ -5,6 +5,7 @@ CONTAINER Gvcsv {
     GROUP ID_GVPROPERTIES {
         BOOL CSVNODE_FORCEOUTPORTS { }
         LONG CSVNODE_FORCEOUTPORTS_COUNT { MIN 0; CUSTOMGUI LONGSLIDER; MINSLIDER 0; MAXSLIDER 15; }
+        BOOL CSVNODE_TYPEDPORTS { }
     }
 
     GROUP ID_GVPORTS {
@@ -0,0 +1,26 @@
+// C4D-DialogResource
+DIALOG IDS_WEBP_DLG_OPTIONS
+{
+  NAME IDS_WEBP_DLG_OPTIONS;
+
+  GROUP IDC_STATIC
+  {
+    NAME IDS_STATIC1; ALIGN_TOP; SCALE_H;
+    BORDERSIZE 4, 4, 4, 4;
+    COLUMNS 2;
+    SPACE 4, 4;
+
+    STATICTEXT IDC_STATIC { NAME IDS_STATIC2; CENTER_V; ALIGN_LEFT; }
+    CHECKBOX IDS_WEBP_CHK_LOSSLESS { NAME IDS_CHECK1; ALIGN_TOP; ALIGN_LEFT; }
+    STATICTEXT IDC_STATIC { NAME IDS_STATIC3; CENTER_V; ALIGN_LEFT; }
+    EDITSLIDER IDS_WEBP_EDT_QUALITY
+    { CENTER_V; SCALE_H; SIZE 150, 0; }
+    STATICTEXT IDC_STATIC { NAME IDS_STATIC4; CENTER_V; ALIGN_LEFT; }
+    EDITSLIDER IDS_WEBP_EDT_METHOD
+    { CENTER_V; SCALE_H; SIZE 150, 0; }
+    STATICTEXT IDC_STATIC { NAME IDS_STATIC5; CENTER_V; ALIGN_LEFT; }
+    CHECKBOX IDS_WEBP_CHK_MULTITHREAD { NAME IDS_CHECK2; ALIGN_TOP; ALIGN_LEFT; }
+  }
+
+  DLGGROUP { OK; CANCEL; }
+}
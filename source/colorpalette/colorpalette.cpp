@@ -191,7 +191,7 @@ public: // GeUserArea Overrides
       if (msg.GetBool(BFM_INPUT_DOUBLECLICK) && swatch) {
         String name = swatch->GetName();
         if (RenameDialog(&name)) {
-          swatch->name = name;
+          data->RenameSwatch(swatch, name);
           parent_msg.SetBool(GUIMSG_VALUE_CHANGED, true);
         }
       }
@@ -593,6 +593,7 @@ Bool ColorPaletteData::Read(HyperFile* hf, Int32 disklevel)
   if (!hf->ReadInt32(&this->next_idx)) return false;
   if (!hf->ReadBool(&this->show_chooser)) return false;
   this->folders.Flush();
+  this->index_valid = false;
   Int32 count;
   if (!hf->ReadInt32(&count)) return false;
   iferr (this->folders.EnsureCapacity(count)) return false;
@@ -601,6 +602,7 @@ Bool ColorPaletteData::Read(HyperFile* hf, Int32 disklevel)
     if (!folder.Read(hf, disklevel)) return false;
     this->folders.Append(std::move(folder));
   }
+  this->RebuildIndex();
   return true;
 }
 
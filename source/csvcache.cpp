@@ -0,0 +1,106 @@
+#include "csvcache.hpp"
+#include "fs.hpp"
+#include <mutex>
+#include <vector>
+
+namespace {
+
+  struct entry
+  {
+    csvcache::key key;
+    std::shared_ptr<csvcache::table> table;
+    size_t memory;
+    uint64_t last_used;
+
+    /* True if no consumer references the table. */
+    bool unused() const { return table.use_count() <= 1; }
+  };
+
+  /* Number of bytes that unused tables may occupy before they are evicted. */
+  size_t const budget = 64 * 1024 * 1024;
+
+  std::mutex lock;
+  std::vector<entry> entries;
+  uint64_t tick = 0;
+
+  /* Evict least recently used, unused tables until they fit the budget. */
+  void evict()
+  {
+    size_t unused_memory = 0;
+    for (auto const& e : entries) {
+      if (e.unused()) unused_memory += e.memory;
+    }
+    while (unused_memory > budget) {
+      auto oldest = entries.end();
+      for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->unused() && (oldest == entries.end() || it->last_used < oldest->last_used))
+          oldest = it;
+      }
+      if (oldest == entries.end()) break;
+      unused_memory -= oldest->memory;
+      entries.erase(oldest);
+    }
+  }
+
+} // namespace
+
+csvcache::key csvcache::make_key(
+  std::string const& kind, std::string const& file, char delim, bool header)
+{
+  key k;
+  k.kind = kind;
+  k.path = fs::canonpath(file);
+  k.delim = delim;
+  k.header = header;
+  k.mtime = fs::getmtime(k.path);
+  return k;
+}
+
+std::shared_ptr<csvcache::table> csvcache::acquire(
+  key const& k, loader const& load, bool force_reload)
+{
+  if (!force_reload) {
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto& e : entries) {
+      if (e.key != k) continue;
+      e.last_used = ++tick;
+      return e.table;
+    }
+  }
+
+  // Parse the file without holding the lock, so that other consumers
+  // can still access the cache meanwhile.
+  std::shared_ptr<table> result = load(k);
+  if (!result) return nullptr;
+  size_t const memory = result->memory_usage();
+
+  std::lock_guard<std::mutex> guard(lock);
+  ++tick;
+
+  // Tables of older versions of the same file are not going to be
+  // requested again, drop them right away if nobody uses them. If
+  // another consumer loaded the same table meanwhile, that one is
+  // used unless a reload was forced.
+  for (auto it = entries.begin(); it != entries.end();) {
+    key const& other = it->key;
+    if (other == k && !force_reload) {
+      it->last_used = tick;
+      return it->table;
+    }
+    bool stale = other.kind == k.kind && other.path == k.path &&
+      other.delim == k.delim && other.header == k.header;
+    if (other == k || (stale && it->unused()))
+      it = entries.erase(it);
+    else ++it;
+  }
+
+  entries.push_back({k, result, memory, tick});
+  evict();
+  return result;
+}
+
+void csvcache::purge()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  entries.clear();
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+/*!
+ * Process-wide cache of parsed CSV tables. All CSV consumers (the CSV
+ * XPresso node, the CSV Effector and the Procedural CSV Reader) load
+ * their tables through this cache, so a file that is used by many of
+ * them is only parsed and stored once.
+ *
+ * Tables are reference counted with `std::shared_ptr`. A table that is
+ * no longer referenced by any consumer stays in the cache as long as
+ * the memory of all unused tables is within a budget of 64 MB, least
+ * recently used tables are evicted first.
+ */
+namespace csvcache {
+
+  /*!
+   * Base class for the tables stored in the cache. The cache does not
+   * care how the data is stored, consumers derive from this class to
+   * wrap their table type.
+   */
+  class table
+  {
+  public:
+    virtual ~table() { }
+
+    /* Return the approximate number of bytes occupied by the table. */
+    virtual size_t memory_usage() const = 0;
+  };
+
+  /*!
+   * Identifies a table in the cache. The @kind separates different
+   * table types that are loaded from the same file.
+   */
+  struct key
+  {
+    std::string kind;
+    std::string path;
+    char delim;
+    bool header;
+    uint64_t mtime;
+
+    bool operator == (key const& other) const
+    {
+      return kind == other.kind && path == other.path && delim == other.delim &&
+        header == other.header && mtime == other.mtime;
+    }
+
+    bool operator != (key const& other) const { return !(*this == other); }
+  };
+
+  /*!
+   * Create the key for @file. The path is made canonical and the
+   * modification time is read from the file system.
+   */
+  key make_key(std::string const& kind, std::string const& file, char delim, bool header);
+
+  /*!
+   * A function that loads a table for the specified key. May return
+   * nullptr if the table could not be allocated.
+   */
+  using loader = std::function<std::shared_ptr<table>(key const&)>;
+
+  /*!
+   * Return the table for @k from the cache or load it with @load if it
+   * is not cached. If @force_reload is true, a cached table is replaced
+   * by a freshly loaded one. Consumers that still hold the old table
+   * keep it alive until they release it. @load is called without the
+   * cache being locked.
+   */
+  std::shared_ptr<table> acquire(key const& k, loader const& load, bool force_reload = false);
+
+  /*!
+   * Typed version of @acquire(). @T must derive from @table and be
+   * constructible from a @key, the constructor loads the table.
+   */
+  template <typename T>
+  std::shared_ptr<T const> acquire(key const& k, bool force_reload = false)
+  {
+    auto load = [](key const& k) -> std::shared_ptr<table> {
+      return std::make_shared<T>(k);
+    };
+    return std::static_pointer_cast<T const>(acquire(k, load, force_reload));
+  }
+
+  /*!
+   * Remove all tables from the cache. Tables that are still in use stay
+   * alive until their consumers release them. Must be called before the
+   * plugin is unloaded.
+   */
+  void purge();
+
+} // namespace csvcache
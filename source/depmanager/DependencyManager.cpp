@@ -202,6 +202,7 @@ public:
   CellLayout cell_enabled;
   CellLayout cell_layer;
   Int32 list_flags;
+  UInt32 dirty;  // DependencyType::GetElementDirty() of the link at the last update
 
   DisplayFlags GetDisplayFlags() const {
     return m_display;
@@ -313,6 +314,7 @@ private:
 
   DepNode() : super() {
     list_flags = 0;
+    dirty = 0;
     #if USE_DIRECT_LINKS
       m_element = nullptr;
     #endif
@@ -366,6 +368,8 @@ public:
 
 };
 
+typedef c4d_apibridge::HashMap<BaseList2D*, UInt32> DepDirtyTable;
+
 class DepNodeManager {
 
   DepNode* m_root;
@@ -373,10 +377,27 @@ class DepNodeManager {
   BaseDocument* m_doc;
   Bool m_showempty;
 
+  /**
+   * The dirty checksums of all elements yielded by the DependencyType
+   * at the last update, and a checksum over all of them (including their
+   * order). Used to skip elements that did not change.
+   */
+  DepDirtyTable m_dirty;
+  UInt32 m_checksum;
+  Bool m_last_showempty;
+
 public:
 
+  enum UpdateResult {
+    Update_Failed,     // There is no tree to display.
+    Update_Rebound,    // The document or type changed, the tree must be re-assigned.
+    Update_Changed,    // Nodes have been updated in place.
+    Update_Unchanged,  // No element changed since the last update.
+  };
+
   DepNodeManager()
-  : m_root(nullptr), m_deptype(), m_doc(nullptr), m_showempty(true) { }
+  : m_root(nullptr), m_deptype(), m_doc(nullptr), m_showempty(true),
+    m_checksum(0), m_last_showempty(true) { }
 
   Bool GetShowEmpty() const { return m_showempty; }
 
@@ -388,27 +409,58 @@ public:
     return m_doc;
   }
 
-  Bool UpdateNodes(const DependencyType& deptype, BaseDocument* doc=nullptr) {
+  /**
+   * Forces the next call to UpdateNodes() to re-evaluate all elements
+   * and to return #Update_Rebound.
+   */
+  void Invalidate() {
+    m_doc = nullptr;
+    m_checksum = 0;
+  }
+
+  UpdateResult UpdateNodes(const DependencyType& deptype, BaseDocument* doc=nullptr) {
     // Default to the active document.
     if (!doc) doc = GetActiveDocument();
 
+    // Everything must be re-evaluated if the document or type changed.
+    Bool rebound = doc != m_doc || deptype.GetPlugin() != m_deptype.GetPlugin();
+    Bool force = rebound || m_showempty != m_last_showempty;
+
     // Override cached values and stop if there is no document
     // to work on.
     m_doc = doc;
     m_deptype = deptype;
-    if (!doc) return false;
+    if (!doc) return Update_Failed;
 
     // Retrieve the root node and quit if there is none.
     DepNode* root = GetRoot();
-    if (!root) return false;
+    if (!root) return Update_Failed;
 
     // If the DependencyType is un-initialized, we will just flush the whole
     // tree.
     if (deptype.GetPlugin() == nullptr) {
       root->flush();
-      return true;
+      m_checksum = 0;
+      return Update_Rebound;
     }
 
+    // Collect the dirty checksums of all elements. This is cheap compared
+    // to retrieving the dependencies of every element, and in most cases
+    // allows us to stop right here.
+    DepDirtyTable dirty;
+    UInt32 checksum = 0;
+    for (BaseList2D* current = m_deptype.GetFirstElement(doc); current;
+         current = nr::c4d::get_next_node(current)) {
+      UInt32 value = m_deptype.GetElementDirty(current);
+      dirty.Put(current, value);
+      checksum = checksum * 31 + (UInt32) (UInt) current + value;
+    }
+    if (!force && checksum == m_checksum) {
+      return Update_Unchanged;
+    }
+    m_checksum = checksum;
+    m_last_showempty = m_showempty;
+
     // Create a rebuild-table which will tell us what nodes do already
     // exist and need not to be re-created (resuling in loss of qualifiers
     // such as opened or selection state).
@@ -420,9 +472,29 @@ public:
     root->SetBit(DepNode::Bit_Reused);
 
     // Iterate over the elements yielded by the DependencyType.
+    Bool changed = rebound;
     BaseList2D* current = m_deptype.GetFirstElement(doc);
     DepNode* prev_node = nullptr;
     while (current) {
+      UInt32 current_dirty = dirty.FindEntry(current)->GetValue();
+      DepNode* node = table.FindNode(current);
+
+      if (!force && _IsUpToDate(current, current_dirty, node, dirty)) {
+        // Nothing changed for this element, only restore its position.
+        if (node) {
+          if (node->GetUp() != root || node->GetPred() != prev_node) {
+            node->Remove();
+            node->InsertAt(root, prev_node);
+            changed = true;
+          }
+          node->BitTree(DepNode::Bit_Reused, true);
+          prev_node = node;
+        }
+        current = nr::c4d::get_next_node(current);
+        continue;
+      }
+      changed = true;
+
       // Retrieve the InExcludeList with the dependencies of the current
       // element. If it doesn't yield a valid list, the object does not
       // need to be represented in the tree.
@@ -440,8 +512,9 @@ public:
 
       if (list) {
         // Is there already a node for the current element?
-        DepNode* node = _FindOrCreateNode(current, nullptr, list, table, DepNode::Type_Source);
+        node = _FindOrCreateNode(current, nullptr, list, table, DepNode::Type_Source, dirty);
         if (node) {
+          node->dirty = current_dirty;
           node->InsertAt(root, prev_node);
           prev_node = node;
         }
@@ -458,6 +531,7 @@ public:
         next = nr::c4d::get_next_node_del(dep_curr);
         dep_curr->Remove();
         DepNode::Free(dep_curr);
+        changed = true;
       }
       else {
         dep_curr->DelBit(DepNode::Bit_Reused);
@@ -467,7 +541,9 @@ public:
       dep_curr = next;
     }
 
-    return true;
+    m_dirty = std::move(dirty);
+    if (rebound) return Update_Rebound;
+    return changed ? Update_Changed : Update_Unchanged;
   }
 
   DepNode* GetRoot() {
@@ -484,8 +560,31 @@ public:
 
 private:
 
+  /**
+   * Returns true if the *element* with the dirty checksum *element_dirty*
+   * and its existing *node* (can be nullptr) did not change since the
+   * last update. The dependencies are only looked up in the *dirty*
+   * table and never dereferenced, as they might have been deleted.
+   */
+  Bool _IsUpToDate(BaseList2D* element, UInt32 element_dirty, DepNode* node,
+        const DepDirtyTable& dirty) {
+    if (!node) {
+      // The element was not displayed the last time, which remains true
+      // as long as it did not change.
+      const DepDirtyTable::Entry* e = m_dirty.FindEntry(element);
+      return e && e->GetValue() == element_dirty;
+    }
+    if (node->dirty != element_dirty) return false;
+
+    for (DepNode* child = node->GetDown(); child; child = child->GetNext()) {
+      const DepDirtyTable::Entry* e = dirty.FindEntry(child->GetLink(m_doc));
+      if (!e || e->GetValue() != child->dirty) return false;
+    }
+    return true;
+  }
+
   DepNode* _FindOrCreateNode(BaseList2D* element, BaseList2D* parent, InExcludeData* list,
-        const DepNodeRebuildTable& table, DepNode::Type type) {
+        const DepNodeRebuildTable& table, DepNode::Type type, const DepDirtyTable& dirty) {
     DepNode* node = table.FindNode(element);
     if (!node) {
       node = DepNode::Alloc(type);
@@ -500,11 +599,12 @@ private:
     node->SetBit(DepNode::Bit_Reused);
     node->SetDisplayFlags(m_deptype.GetDisplayFlags(element, parent, list));
 
-    if (list && !parent) _CreateDependencyNodes(node, element, list);
+    if (list && !parent) _CreateDependencyNodes(node, element, list, dirty);
     return node;
   }
 
-  void _CreateDependencyNodes(DepNode* source, BaseList2D* element, InExcludeData* list) {
+  void _CreateDependencyNodes(DepNode* source, BaseList2D* element, InExcludeData* list,
+        const DepDirtyTable& dirty) {
     if (!source || !element || !list) return;
 
     // Build a table for re-using already available nodes.
@@ -517,11 +617,13 @@ private:
       BaseList2D* current = list->ObjectFromIndex(m_doc, i);
       if (!current) continue;
 
-      DepNode* node = _FindOrCreateNode(current, element, list, table, DepNode::Type_Dependency);
+      DepNode* node = _FindOrCreateNode(current, element, list, table, DepNode::Type_Dependency, dirty);
       if (node) {
         // Write the flags of the node in the list to the node so it
         // can be re-used when re-writing the list.
         node->list_flags = list->GetFlags(i);
+        const DepDirtyTable::Entry* e = dirty.FindEntry(current);
+        node->dirty = e ? e->GetValue() : m_deptype.GetElementDirty(current);
         node->InsertAt(source, prev_node);
         prev_node = node;
       }
@@ -1312,6 +1414,7 @@ public:
   virtual Bool CreateLayout() {
     // Initialize pointer members.
     m_treeview = nullptr;
+    m_manager.Invalidate();
 
     // Generate the dialog's title.
     m_title = GeLoadString(IDC_DEPENDENCYMANAGER_NAME);
@@ -1415,11 +1518,20 @@ private:
     if (!m_treeview) return;
     m_model.SetTreeLayout(m_treeview);
 
-    if (m_manager.UpdateNodes(g_typemng->GetDependencyType(m_active))) {
-      m_treeview->SetRoot(&m_manager, &m_model, GetActiveDocument());
-    }
-    else {
-      m_treeview->SetRoot(nullptr, nullptr, nullptr);
+    switch (m_manager.UpdateNodes(g_typemng->GetDependencyType(m_active))) {
+      case DepNodeManager::Update_Failed:
+        m_treeview->SetRoot(nullptr, nullptr, nullptr);
+        break;
+      case DepNodeManager::Update_Rebound:
+        m_treeview->SetRoot(&m_manager, &m_model, GetActiveDocument());
+        break;
+      case DepNodeManager::Update_Changed:
+      case DepNodeManager::Update_Unchanged:
+        // The nodes are patched in place, we only need to redraw (eg. to
+        // display selection changes which are not reflected in the dirty
+        // checksums).
+        m_treeview->Refresh();
+        break;
     }
   }
 
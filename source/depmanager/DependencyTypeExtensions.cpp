@@ -8,6 +8,7 @@
 #define PRINT_PREFIX "[nr-toolbox/DependencyManager]: "
 
 #include <c4d.h>
+#include <c4d_apibridge.h>
 #include <c4d_baseeffectordata.h>
 #include <lib_activeobjectmanager.h>
 #include <dynrigidbodytag.h>
@@ -75,6 +76,24 @@ protected:
   };
   maxon::BaseArray<InfoTuple> m_depinfos;
 
+  /**
+   * How potential dependencies of a specific plugin type are accepted,
+   * derived from @attr`m_deptypes` and @attr`m_depinfos`.
+   */
+  struct AcceptEntry {
+    Bool always;  // The type or one of its base types is in m_deptypes
+    Int32 flags;  // Accepted if the element info has any of these flags
+  };
+
+  /**
+   * Dispatch table from plugin type to #AcceptEntry, so that
+   * AcceptDependency() does not need to test every registered type
+   * for every element. The base types of a type can only be tested on
+   * an instance, thus an entry is created when a type is encountered
+   * for the first time.
+   */
+  c4d_apibridge::HashMap<Int32, AcceptEntry> m_accept;
+
   /**
    * A bitfield which is toggled in the flags of an item in an
    * @class`InExcludeData` for activation (eg. effectors). Can be
@@ -82,11 +101,44 @@ protected:
    */
   Int32 m_subcheckmark_flag;
 
+  /**
+   * Caches for every plugin type (the key) whether its description
+   * contains the @attr`m_paramid` parameter. Building the description
+   * of every element on every update is very expensive, while the
+   * answer never changes for a type. Note that @attr`m_paramid` can
+   * not be a user data parameter, so dynamic descriptions do not need
+   * to be taken into account.
+   */
+  c4d_apibridge::HashMap<Int32, Bool> m_hasparam;
+
+  /**
+   * Returns true if the @attr`m_paramid` parameter exists in the
+   * description of *element*, using the @attr`m_hasparam` cache.
+   */
+  Bool HasDependencyParameter(BaseList2D* element) {
+    maxon::Bool created = false;
+    auto entry = m_hasparam.FindOrCreateEntry(element->GetType(), created);
+    if (!entry) return false;
+    if (created) {
+      entry->GetValue() = false;
+      DescID const id(DescLevel(m_paramid, CUSTOMDATATYPE_INEXCLUDE_LIST, 0));
+      AutoAlloc<Description> desc;
+      if (desc) {
+        desc->SetSingleDescriptionMode(id);
+        if (element->GetDescription(desc, DESCFLAGS_DESC_0)) {
+          entry->GetValue() = desc->GetParameterI(id, nullptr) != nullptr;
+        }
+      }
+    }
+    return entry->GetValue();
+  }
+
 protected:
 
   /**
    * Subclasses may call this method to make the AcceptDependency()
-   * method accept the specified type id.
+   * method accept the specified type id. Must only be called from the
+   * constructor, before the dispatch table is populated.
    */
   void AddAcceptedDependency(Int32 type_id) {
     m_deptypes.Append(type_id);
@@ -142,35 +194,37 @@ public:
     if (m_deptypes.GetCount() <= 0 && m_depinfos.GetCount() <= 0)
       return true;
 
-    for (Int32 i=0; i < m_deptypes.GetCount(); i++) {
-      if (pot_dependency->IsInstanceOf(m_deptypes[i])) return true;
-    }
-
-    for (Int32 i=0; i < m_depinfos.GetCount(); i++) {
-      const InfoTuple& info = m_depinfos[i];
-      if (pot_dependency->IsInstanceOf(info.base_id)) {
-        if (pot_dependency->GetInfo() & info.flags)
-          return true;
+    maxon::Bool created = false;
+    auto entry = m_accept.FindOrCreateEntry(pot_dependency->GetType(), created);
+    if (!entry) return false;
+
+    AcceptEntry& accept = entry->GetValue();
+    if (created) {
+      accept.always = false;
+      accept.flags = 0;
+      for (Int32 i=0; i < m_deptypes.GetCount(); i++) {
+        if (pot_dependency->IsInstanceOf(m_deptypes[i])) {
+          accept.always = true;
+          break;
+        }
+      }
+      for (Int32 i=0; i < m_depinfos.GetCount(); i++) {
+        const InfoTuple& info = m_depinfos[i];
+        if (pot_dependency->IsInstanceOf(info.base_id))
+          accept.flags |= info.flags;
       }
     }
 
-    return false;
+    if (accept.always) return true;
+    return (pot_dependency->GetInfo() & accept.flags) != 0;
   }
 
   virtual Bool GetElementDependencies(BaseList2D* element, GeData& dest) {
     element = GetElementFromElement(element);
     if (!element) return false;
-    DescID const id(DescLevel(m_paramid, CUSTOMDATATYPE_INEXCLUDE_LIST, 0));
 
     // Check if there should be such a parameter.
-    AutoAlloc<Description> desc;
-    if (!desc) return false;
-    desc->SetSingleDescriptionMode(id);
-    if (!element->GetDescription(desc, DESCFLAGS_DESC_0)) return false;
-
-    // Does the parmaeter actually exist?
-    BaseContainer* ibc = desc->GetParameterI(id, nullptr);
-    if (!ibc) return false;
+    if (!HasDependencyParameter(element)) return false;
 
     element->GetParameter(m_paramid, dest, DESCFLAGS_GET_0);
     if (dest.GetType() == DA_NIL) {
@@ -187,6 +241,16 @@ public:
     return element->SetParameter(m_paramid, data, DESCFLAGS_SET_0);
   }
 
+  virtual UInt32 GetElementDirty(BaseList2D* element) {
+    UInt32 dirty = super::GetElementDirty(element);
+    BaseList2D* target = GetElementFromElement(element);
+    if (target && target != element) {
+      // The dependencies are stored in a tag of the element.
+      dirty = dirty * 31 + (UInt32) (UInt) target + target->GetDirty(DIRTYFLAGS_DATA);
+    }
+    return dirty;
+  }
+
   virtual DisplayFlags GetDisplayFlags(BaseList2D* element, BaseList2D* parent, InExcludeData* parent_list) {
     if (!element) return {};
     DisplayFlags flags;
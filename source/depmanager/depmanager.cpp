@@ -24,6 +24,11 @@ Int32 DependencyTypeData::GetDefaultInExFlags(BaseList2D* element, BaseList2D* p
   return 0;
 }
 
+UInt32 DependencyTypeData::GetElementDirty(BaseList2D* element) {
+  if (!element) return 0;
+  return element->GetDirty(DIRTYFLAGS_DATA);
+}
+
 Bool DependencyTypeData::RemoveElement(BaseList2D* element, BaseList2D* parent) {
   if (element && parent) {
     BaseDocument* doc = element->GetDocument();
@@ -96,6 +101,7 @@ Bool FillDependencyTypePlugin(DEPENDENCYTYPEPLUGIN* plugin, Int32 info, BaseData
   plugin->GetDefaultInExFlags     = &DependencyTypeData::GetDefaultInExFlags;
   plugin->GetElementDependencies  = &DependencyTypeData::GetElementDependencies;
   plugin->SetElementDependencies  = &DependencyTypeData::SetElementDependencies;
+  plugin->GetElementDirty         = &DependencyTypeData::GetElementDirty;
   plugin->GetDisplayFlags         = &DependencyTypeData::GetDisplayFlags;
   plugin->RemoveElement           = &DependencyTypeData::RemoveElement;
 
@@ -196,6 +196,15 @@ namespace depmanager {
      */
     virtual Bool SetElementDependencies(BaseList2D* element, const GeData& data) = 0;
 
+    /**
+     * Override this method to return a checksum that changes whenever
+     * the dependencies or the display of the element change. The
+     * Dependency Manager only re-evaluates elements whose checksum
+     * changed. The default implementation returns the data dirty count
+     * of the element.
+     */
+    virtual UInt32 GetElementDirty(BaseList2D* element);
+
     /**
      * Override this method to specify display flags for an element in
      * the Dependency Manager tree. If `parent` is `nullptr`, the element
@@ -266,6 +275,7 @@ namespace depmanager {
     Int32 (DependencyTypeData::*GetDefaultInExFlags)(BaseList2D* element, BaseList2D* pot_dependency);
     Bool (DependencyTypeData::*GetElementDependencies)(BaseList2D* element, GeData& dest);
     Bool (DependencyTypeData::*SetElementDependencies)(BaseList2D* element, const GeData& dest);
+    UInt32 (DependencyTypeData::*GetElementDirty)(BaseList2D* element);
     DisplayFlags (DependencyTypeData::*GetDisplayFlags)(BaseList2D* element, BaseList2D* parent, InExcludeData* parent_list);
     Bool (DependencyTypeData::*RemoveElement)(BaseList2D* element, BaseList2D* parent);
     Bool (DependencyTypeData::*Message)(BaseList2D* element, BaseList2D* parent, Int32 type, void* p_data);
@@ -341,6 +351,12 @@ namespace depmanager {
       return false;
     }
 
+    UInt32 GetElementDirty(BaseList2D* element) {
+      DependencyTypeData* data = GetData();
+      if (data) return (data->*(m_plugin->GetElementDirty))(element);
+      return 0;
+    }
+
     DisplayFlags GetDisplayFlags(BaseList2D* element, BaseList2D* parent, InExcludeData* parent_list) {
       DependencyTypeData* data = GetData();
       if (data) return (data->*(m_plugin->GetDisplayFlags))(element, parent, parent_list);
@@ -2,22 +2,73 @@
 
 #if defined(_WIN32)
   #include <Windows.h>
+  #include <cstdlib>
+
+  namespace {
+
+    /* Convert a UTF-8 string to UTF-16. Returns an empty string on failure. */
+    std::wstring widen(char const* str)
+    {
+      int const len = MultiByteToWideChar(CP_UTF8, 0, str, -1, nullptr, 0);
+      if (len <= 0)
+        return std::wstring();
+      std::wstring result(static_cast<size_t>(len), L'\0');
+      MultiByteToWideChar(CP_UTF8, 0, str, -1, &result[0], len);
+      result.resize(static_cast<size_t>(len - 1));
+      return result;
+    }
+
+    /* Convert a UTF-16 string to UTF-8. Returns an empty string on failure. */
+    std::string narrow(wchar_t const* str)
+    {
+      int const len = WideCharToMultiByte(CP_UTF8, 0, str, -1, nullptr, 0, nullptr, nullptr);
+      if (len <= 0)
+        return std::string();
+      std::string result(static_cast<size_t>(len), '\0');
+      WideCharToMultiByte(CP_UTF8, 0, str, -1, &result[0], len, nullptr, nullptr);
+      result.resize(static_cast<size_t>(len - 1));
+      return result;
+    }
+
+  } // namespace
 
   uint64_t fs::getmtime(char const* file)
   {
+    std::wstring const wfile = widen(file);
+    if (wfile.empty())
+      return 0;
     FILETIME mt;
     DWORD const flags = FILE_SHARE_DELETE | FILE_SHARE_WRITE | FILE_SHARE_READ;
-    HANDLE const fp = CreateFileA(
-      file, GENERIC_READ, flags, nullptr, OPEN_ALWAYS, 0, nullptr);
-    if (fp && GetFileTime(fp, nullptr, nullptr, &mt)) {
+    HANDLE const fp = CreateFileW(
+      wfile.c_str(), GENERIC_READ, flags, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (fp == INVALID_HANDLE_VALUE)
+      return 0;
+    uint64_t result = 0;
+    if (GetFileTime(fp, nullptr, nullptr, &mt)) {
       // Convert the FILETIME structure to a 64-Bit number.
-      return static_cast<uint64_t>(mt.dwHighDateTime) << 32 | mt.dwLowDateTime;
+      result = static_cast<uint64_t>(mt.dwHighDateTime) << 32 | mt.dwLowDateTime;
     }
-    return 0;
+    CloseHandle(fp);
+    return result;
+  }
+
+  std::string fs::canonpath(char const* file)
+  {
+    std::wstring const wfile = widen(file);
+    wchar_t buffer[MAX_PATH];
+    if (wfile.empty() || !_wfullpath(buffer, wfile.c_str(), MAX_PATH))
+      return file;
+    for (wchar_t* c = buffer; *c; ++c) {
+      if (*c == L'/') *c = L'\\';
+    }
+    CharLowerW(buffer);
+    std::string const result = narrow(buffer);
+    return result.empty() ? std::string(file) : result;
   }
 
 #elif defined(__APPLE__) || defined(__linux__) || defined(__GNUC__)
   #include <sys/stat.h>
+  #include <cstdlib>
 
   uint64_t fs::getmtime(char const* file)
   {
@@ -26,6 +77,16 @@
     return buf.st_mtime;
   }
 
+  std::string fs::canonpath(char const* file)
+  {
+    char* path = realpath(file, nullptr);
+    if (!path)
+      return file;
+    std::string result = path;
+    free(path);
+    return result;
+  }
+
 #else
   #error "Unknown compiler or platform"
 #endif
@@ -3,6 +3,10 @@
 #include <cstdint>
 #include <string>
 
+/*!
+ * File system helpers. All paths are UTF-8 encoded, on Windows they are
+ * converted to UTF-16 for the wide character API.
+ */
 namespace fs {
 
   /*!
@@ -14,4 +18,15 @@ namespace fs {
   inline uint64_t getmtime(std::string const& file) { return getmtime(file.c_str()); }
   // @}
 
+  /*!
+   * Return the canonical absolute path of a file, with all symbolic
+   * links and relative components resolved. On case-insensitive
+   * platforms the result is lower-cased. Returns @file unchanged if it
+   * can not be resolved (eg. if the file does not exist).
+   */
+  // @{
+  std::string canonpath(char const* file);
+  inline std::string canonpath(std::string const& file) { return canonpath(file.c_str()); }
+  // @}
+
 } // namespace fs
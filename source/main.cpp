@@ -8,6 +8,7 @@
 #include "res/c4d_symbols.h"
 #include "misc/print.h"
 #include "config.h"
+#include "csvcache.hpp"
 #include "menu.h"
 #include "GIT_VERSION.h"
 
@@ -141,6 +142,7 @@ Bool PluginStart() {
 //============================================================================
 //============================================================================
 void PluginEnd() {
+  csvcache::purge();
   nr::c4d::do_cleanup();
 }
 
@@ -2,6 +2,7 @@
  * All rights reserved. */
 
 #include <c4d.h>
+#include <c4d_apibridge.h>
 #include <NiklasRosenstein/macros.hpp>
 #include <NiklasRosenstein/c4d/utils.hpp>
 #include <NiklasRosenstein/c4d/fmap.hpp>
@@ -16,36 +17,266 @@ namespace nr { using namespace niklasrosenstein; }
 using nr::c4d::get_param;
 using nr::c4d::set_param;
 
-static Bool DrawObjectUVs(PolygonObject* op, BaseDraw* bd)
+/* Caches the UV edges of polygon objects for the "Show UVs" viewport
+ * option. Every edge shared by multiple polygons is only stored once,
+ * and consecutive edges of a polygon are joined to line strips. Entries
+ * are identified by the object's GUID. An entry is rebuilt when it was
+ * built for another object at the same address, or when the object or
+ * its UVW tag become dirty. */
+class UVOverlayCache
 {
-  if (!op || op->GetType() != Opolygon)
-    return false;
-
-  UVWTag* tag = static_cast<UVWTag*>(op->GetTag(Tuvw));
-  CPolygon const* polys = op->GetPolygonR();
-  Vector const* points = op->GetPointR();
-  if (!polys || !points || !tag)
-    return false;
-
-
-  bd->SetMatrix_Matrix(op, op->GetMg());
-  Int32 const count = op->GetPolygonCount();
-  ConstUVWHandle uvwhandle = tag->GetDataAddressR();
-  for (Int32 i = 0; i < count; ++i) {
-    CPolygon const& f = polys[i];
-    Vector p[4] = {points[f.a], points[f.b], points[f.c], points[f.d]};
-    UVWStruct c;
-    UVWTag::Get(uvwhandle, i, c);
-    c.a.z = c.b.z = c.c.z = c.d.z = 0.0;
-    bd->DrawPolygon(p, &c.a, f.c != f.d);
+  struct Entry
+  {
+    Bool valid = false;
+    Int64 guid = 0;
+    UInt32 op_dirty = 0;
+    UInt32 tag_dirty = 0;
+    maxon::BaseArray<Vector> points;  // Vertices of all strips
+    maxon::BaseArray<Vector> colors;  // UV coordinates per vertex
+    maxon::BaseArray<Int32> strips;   // Vertex count per strip
+  };
+
+  // Entries are keyed by the object. Cache clones of a generator can
+  // share the same GUID, and a freed object's address can be reused by
+  // another object, so an entry is only valid if both match.
+  typedef c4d_apibridge::HashMap<PolygonObject const*, Entry> EntryMap;
+
+  // The entries of the previous and the current draw pass. Entries
+  // of objects that are not drawn anymore are dropped with EndDraw().
+  EntryMap m_entries;
+  EntryMap m_current;
+
+  static Bool Build(Entry& entry, PolygonObject* op, UVWTag* tag)
+  {
+    entry.points.Flush();
+    entry.colors.Flush();
+    entry.strips.Flush();
+
+    CPolygon const* polys = op->GetPolygonR();
+    Vector const* points = op->GetPointR();
+    Int32 const count = op->GetPolygonCount();
+    ConstUVWHandle uvwhandle = tag->GetDataAddressR();
+    c4d_apibridge::HashMap<UInt64, Bool> edges;
+
+    for (Int32 i = 0; i < count; ++i) {
+      CPolygon const& f = polys[i];
+      Int32 const n = (f.c == f.d ? 3 : 4);
+      Int32 const index[4] = {f.a, f.b, f.c, f.d};
+      UVWStruct c;
+      UVWTag::Get(uvwhandle, i, c);
+      Vector const uv[4] = {c.a, c.b, c.c, c.d};
+
+      // An edge is owned by the first polygon that uses it.
+      Bool owned[4];
+      Int32 num_owned = 0;
+      for (Int32 k = 0; k < n; ++k) {
+        UInt64 a = (UInt64) index[k], b = (UInt64) index[(k + 1) % n];
+        if (a > b) { UInt64 const t = a; a = b; b = t; }
+        maxon::Bool created = false;
+        auto e = edges.FindOrCreateEntry((a << 32) | b, created);
+        owned[k] = !e || created;
+        if (owned[k]) ++num_owned;
+      }
+      if (num_owned == 0) continue;
+
+      // Emit every run of owned edges as a line strip. If all edges are
+      // owned, the strip is closed and starts at the first corner.
+      Int32 first = 0;
+      if (num_owned != n) {
+        while (!(owned[first] && !owned[(first + n - 1) % n])) ++first;
+      }
+      for (Int32 k = 0; k < n;) {
+        Int32 const start = (first + k) % n;
+        if (!owned[start]) { ++k; continue; }
+        Int32 length = 0;
+        while (k < n && owned[(first + k) % n]) { ++length; ++k; }
+        for (Int32 j = 0; j <= length; ++j) {
+          Int32 const corner = (start + j) % n;
+          iferr (entry.points.Append(points[index[corner]])) return false;
+          iferr (entry.colors.Append(Vector(uv[corner].x, uv[corner].y, 0.0))) return false;
+        }
+        iferr (entry.strips.Append(length + 1)) return false;
+      }
+    }
+    return true;
   }
-	return true;
-}
+
+public:
+
+  Bool Draw(PolygonObject* op, BaseDraw* bd)
+  {
+    if (!op || op->GetType() != Opolygon)
+      return false;
+
+    UVWTag* tag = static_cast<UVWTag*>(op->GetTag(Tuvw));
+    if (!op->GetPolygonR() || !op->GetPointR() || !tag)
+      return false;
+
+    Int64 const guid = op->GetGUID();
+    maxon::Bool created = false;
+    auto current = m_current.FindOrCreateEntry(op, created);
+    if (!current) return false;
+    Entry& entry = current->GetValue();
+
+    UInt32 const op_dirty = op->GetDirty(DIRTYFLAGS_DATA);
+    UInt32 const tag_dirty = tag->GetDirty(DIRTYFLAGS_DATA);
+    if (created) {
+      auto prev = m_entries.FindEntry(op);
+      if (prev) entry = std::move(prev->GetValue());
+    }
+    if (!entry.valid || entry.guid != guid || entry.op_dirty != op_dirty || entry.tag_dirty != tag_dirty) {
+      entry.valid = Build(entry, op, tag);
+      if (!entry.valid) {
+        entry.strips.Flush();
+        return false;
+      }
+      entry.guid = guid;
+      entry.op_dirty = op_dirty;
+      entry.tag_dirty = tag_dirty;
+    }
+
+    bd->SetMatrix_Matrix(op, op->GetMg());
+    Int32 vertex = 0;
+    for (Int32 const length : entry.strips) {
+      bd->LineStripBegin();
+      for (Int32 j = 0; j < length; ++j, ++vertex) {
+        bd->LineStrip(entry.points[vertex], entry.colors[vertex], 0);
+      }
+      bd->LineStripEnd();
+    }
+    return true;
+  }
+
+  /* Drops the entries of all objects that have not been drawn since
+   * the last call. */
+  void EndDraw()
+  {
+    m_entries = std::move(m_current);
+    m_current = EntryMap();
+  }
+
+  void Flush()
+  {
+    m_entries = EntryMap();
+    m_current = EntryMap();
+  }
+
+};
+
+/* Keeps Color shaders named "swatch:<name>" in sync with the swatches of
+ * the nr-toolbox palette. The bound shaders are only collected again when
+ * the materials may have changed (see Invalidate()), and their colors are
+ * only updated when the palette or the set of bound shaders changed. */
+class SwatchSync
+{
+  struct Binding
+  {
+    BaseLink* link;
+    String name;
+  };
+
+  maxon::BaseArray<Binding> m_bindings;
+  UInt32 m_checksum = 0;       // Checksum over all materials and shaders
+  UInt32 m_palette_dirty = 0;  // Dirty count of the hook at the last Apply()
+  Bool m_stale = true;         // The materials may have changed
+  Bool m_changed = true;       // The bindings changed since the last Apply()
+
+  static UInt32 GetChecksum(BaseDocument* doc)
+  {
+    UInt32 value = 0;
+    for (auto* mat = doc->GetFirstMaterial(); mat; mat = mat->GetNext()) {
+      value = value * 31 + (UInt32) (UInt) mat + mat->GetDirty(DIRTYFLAGS_DATA);
+      for (auto& shader : nr::c4d::iter_hierarchy<BaseShader>(mat->GetFirstShader(), false)) {
+        value = value * 31 + shader->GetDirty(DIRTYFLAGS_DATA);
+      }
+    }
+    return value;
+  }
+
+  Bool Bind(BaseShader* shader, String const& name)
+  {
+    BaseLink* link = BaseLink::Alloc();
+    if (!link) return false;
+    link->SetLink(shader);
+    iferr (m_bindings.Append(Binding{link, name})) {
+      BaseLink::Free(link);
+      return false;
+    }
+    return true;
+  }
+
+public:
+
+  ~SwatchSync() { Flush(); }
+
+  /* Must be called when the document changed. The next Update() will
+   * check if the materials changed. */
+  void Invalidate() { m_stale = true; }
+
+  void Flush()
+  {
+    for (auto& binding : m_bindings)
+      BaseLink::Free(binding.link);
+    m_bindings.Flush();
+    m_checksum = 0;
+    m_stale = m_changed = true;
+  }
+
+  /* Collects the bound shaders again if the materials changed. */
+  void Update(BaseDocument* doc)
+  {
+    if (!m_stale) return;
+    m_stale = false;
+    UInt32 const checksum = GetChecksum(doc);
+    if (checksum == m_checksum) return;
+
+    Flush();
+    m_stale = false;
+    m_checksum = checksum;
+    for (auto* mat = doc->GetFirstMaterial(); mat; mat = mat->GetNext()) {
+      for (auto& shader : nr::c4d::iter_hierarchy<BaseShader>(mat->GetFirstShader(), false)) {
+        if (shader->GetType() != Xcolor) continue;
+        String name = shader->GetName();
+        if (name.SubStr(0, 7).ToLower() != "swatch:") continue;
+        name = name.SubStr(7, name.GetLength() - 7);
+        if (!Bind(shader, name)) return;
+      }
+    }
+  }
+
+  /* Returns true if the colors need to be updated with Apply(). */
+  Bool NeedsApply(UInt32 palette_dirty) const
+  {
+    return m_changed || palette_dirty != m_palette_dirty;
+  }
+
+  void Apply(BaseDocument* doc, nr::ColorPaletteData const* colors, UInt32 palette_dirty)
+  {
+    Bool modified = false;
+    for (auto& binding : m_bindings) {
+      BaseShader* shader = static_cast<BaseShader*>(binding.link->GetLink(doc, Xbase));
+      if (!shader) continue;
+      nr::Swatch const* swatch = colors->Find(binding.name);
+      if (!swatch) continue;
+      if (get_param(shader, COLORSHADER_COLOR).GetVector() != swatch->color) {
+        set_param(shader, COLORSHADER_COLOR, swatch->color);
+        modified = true;
+      }
+    }
+    // Changing the shaders is not a reason to collect them again.
+    if (modified) m_checksum = GetChecksum(doc);
+    m_palette_dirty = palette_dirty;
+    m_changed = false;
+  }
+
+};
 
 class ToolboxHook : public SceneHookData
 {
   typedef SceneHookData super;
 	THStats* thstats = nullptr;
+	UVOverlayCache uvcache;
+	SwatchSync swatches;
 
 public:
 
@@ -95,15 +326,18 @@ public: // SceneHookData Overrides
     BaseContainer* data = hook->GetDataInstance();
     if (!data) return false;
 
+    if (!data->GetBool(NRTOOLBOX_HOOK_VIEWPORT_SHOWUVS))
+      this->uvcache.Flush();
     NR_IF (data->GetBool(NRTOOLBOX_HOOK_VIEWPORT_SHOWUVS)) {
 			if (bd->GetDrawPass() != DRAWPASS_OBJECT) break;
 			bd->SetLightList(BDRAW_SETLIGHTLIST_NOLIGHTS);
 			for (auto& op : nr::c4d::iter_hierarchy<BaseObject>(doc->GetFirstObject(), false)) {
-				for_each_polyobj(op, true, false, [bd](PolygonObject* obj) {
-					DrawObjectUVs(obj, bd);
+				for_each_polyobj(op, true, false, [this, bd](PolygonObject* obj) {
+					this->uvcache.Draw(obj, bd);
 					return true;
 				});
 			}
+			this->uvcache.EndDraw();
     }
 
     return true;
@@ -113,23 +347,14 @@ public: // SceneHookData Overrides
 		BaseThread* bt, Int32 priority, EXECUTIONFLAGS) override
 	{
 		NR_IF (get_param(hook, NRTOOLBOX_HOOK_SWATCHES_SYNCHRONIZE).GetBool()) {
-			// TODO: Filter calls in which the synchronization is performed
 			// TODO: Support shader updates on nodes other than materials
+			this->swatches.Update(doc);
+			UInt32 const palette_dirty = hook->GetDirty(DIRTYFLAGS_DATA);
+			if (!this->swatches.NeedsApply(palette_dirty)) break;
 			GeData data = get_param(hook, NRTOOLBOX_HOOK_SWATCHES);
 			nr::ColorPaletteData* colors = nr::ColorPaletteData::Get(data);
 			if (!colors) break;
-			for (auto* mat = doc->GetFirstMaterial(); mat; mat = mat->GetNext()) {
-				for (auto& shader : nr::c4d::iter_hierarchy<BaseShader>(mat->GetFirstShader(), false)) {
-					if (shader->GetType() != Xcolor) continue;
-					String name = shader->GetName();
-					if (name.SubStr(0, 7).ToLower() != "swatch:") continue;
-					name = name.SubStr(7, name.GetLength() - 7);
-					nr::Swatch const* swatch = colors->Find(name);
-					if (swatch) {
-						set_param(shader, COLORSHADER_COLOR, swatch->color);
-					}
-				}
-			}
+			this->swatches.Apply(doc, colors, palette_dirty);
 		}
 		return EXECUTIONRESULT_OK;
 	}
@@ -158,6 +383,7 @@ public: // NodeData Overrides
 	virtual void Free(GeListNode* node) override
 	{
 		THFreeStats(this->thstats);
+		this->swatches.Flush();
 		super::Free(node);
 	}
 
@@ -175,6 +401,13 @@ public: // NodeData Overrides
 	virtual Bool Message(GeListNode* node, Int32 msg, void* pdata) override
 	{
 		this->thstats = THMessage(this->thstats, static_cast<BaseSceneHook*>(node), node->GetDocument(), msg, pdata);
+		switch (msg) {
+			case MSG_TIMEHIDE_EVMSG_CHANGE:
+			case MSG_DOCUMENTINFO:
+				// Materials or shaders might have been added, renamed or removed.
+				this->swatches.Invalidate();
+				break;
+		}
 		return super::Message(node, msg, pdata);
 	}
 
@@ -341,51 +574,75 @@ public: // VideoPostData Overrides
 	virtual void ExecuteLine(BaseVideoPost* node, PixelPost* pp)
 	{
 		Int32 const y = pp->line;
-		Int32 i, x;
-
-		// This pointer represents the current color pixel. It is
-		// incremented during iteration.
-		Float32* col = pp->col;
+		Int32 const xmin = pp->xmin;
+		Int32 const xmax = pp->xmax;
 
 		// If anti-aliasing is enabled, there are 4 subpixels for each
 		// pixel, or only one real pixel if anti-aliasing is not enabled.
 		Int32 const subpixels = (pp->aa ? 4 : 1);
+		Int32 const stride = pp->comp * subpixels;
+
+		// Lines on the top and bottom edge of the safe frame are a border
+		// across their full width, lines outside of it are overlaid
+		// completely except for the two border columns. Inside the safe
+		// frame, only the spans left and right of it are touched.
+		if (y == m_rect.y1 || y == m_rect.y2) {
+			DrawSpan(pp, xmin, xmax, subpixels, stride, true);
+		}
+		else if (y < m_rect.y1 || y > m_rect.y2) {
+			DrawSpan(pp, xmin, Min(xmax, m_rect.x1 - 1), subpixels, stride, false);
+			DrawSpan(pp, Max(xmin, m_rect.x1), Min(xmax, m_rect.x1), subpixels, stride, true);
+			DrawSpan(pp, Max(xmin, m_rect.x1 + 1), Min(xmax, m_rect.x2 - 1), subpixels, stride, false);
+			if (m_rect.x2 != m_rect.x1)
+				DrawSpan(pp, Max(xmin, m_rect.x2), Min(xmax, m_rect.x2), subpixels, stride, true);
+			DrawSpan(pp, Max(xmin, m_rect.x2 + 1), xmax, subpixels, stride, false);
+		}
+		else {
+			DrawSpan(pp, xmin, Min(xmax, m_rect.x1 - 1), subpixels, stride, false);
+			DrawSpan(pp, Max(xmin, m_rect.x1), Min(xmax, m_rect.x1), subpixels, stride, true);
+			if (m_rect.x2 != m_rect.x1)
+				DrawSpan(pp, Max(xmin, m_rect.x2), Min(xmax, m_rect.x2), subpixels, stride, true);
+			DrawSpan(pp, Max(xmin, m_rect.x2 + 1), xmax, subpixels, stride, false);
+		}
+	}
 
-		for (x = pp->xmin; x <= pp->xmax; x++) {
-			// Determine if the current pixel is within the safe
-			// frame or not.
-			Bool safe    = x > m_rect.x1 && x < m_rect.x2;
-			safe = safe && y > m_rect.y1 && y < m_rect.y2;
-
-			if (safe) {
-				// Update the pixel-buffer pointer as if it was
-				// run through a loop that modifies each subpixel
-				// (see below).
-				col += pp->comp * subpixels;
-				continue;
-			}
-
-			Bool on_border = (y == m_rect.y1 || y == m_rect.y2 ||
-						x == m_rect.x1 || x == m_rect.x2);
+private:
 
-			if (m_border && on_border) {
-				// We'll draw the border on the left side of the AA pixel
-				// only to get a decent and sharp border.
-				for (i = 0; i < subpixels; i += 2) {
-					(col + i * pp->comp)[0] = m_border_color.x;
-					(col + i * pp->comp)[1] = m_border_color.y;
-					(col + i * pp->comp)[2] = m_border_color.z;
+	// Draws the border or the overlay on the pixels from x1 to x2
+	// (inclusive) of the current line.
+	void DrawSpan(PixelPost* pp, Int32 x1, Int32 x2, Int32 subpixels, Int32 stride, Bool border)
+	{
+		if (x1 > x2) return;
+		Float32* col = pp->col + (x1 - pp->xmin) * stride;
+		Int32 const comp = pp->comp;
+
+		if (border && m_border) {
+			// We'll draw the border on the left side of the AA pixel
+			// only to get a decent and sharp border.
+			Float32 const r = (Float32) m_border_color.x;
+			Float32 const g = (Float32) m_border_color.y;
+			Float32 const b = (Float32) m_border_color.z;
+			for (Int32 x = x1; x <= x2; ++x, col += stride) {
+				for (Int32 i = 0; i < subpixels; i += 2) {
+					Float32* sub = col + i * comp;
+					sub[0] = r;
+					sub[1] = g;
+					sub[2] = b;
 				}
-				col += pp->comp * subpixels;
 			}
-			else {
-				// Otherwise, we'll overwrite all pixels to the
-				// specified overlay color.
-				for (i = 0; i < subpixels; i++, col += pp->comp) {
-					col[0] = OverlayColorValue(col[0], m_color.x, m_alpha);
-					col[1] = OverlayColorValue(col[1], m_color.y, m_alpha);
-					col[2] = OverlayColorValue(col[2], m_color.z, m_alpha);
-				}
+		}
+		else {
+			// Otherwise, we'll overwrite all pixels to the
+			// specified overlay color.
+			Float32 const alpha = (Float32) m_alpha;
+			Float32 const r = (Float32) m_color.x;
+			Float32 const g = (Float32) m_color.y;
+			Float32 const b = (Float32) m_color.z;
+			Float32* const end = col + (x2 - x1 + 1) * stride;
+			for (; col < end; col += comp) {
+				col[0] = OverlayColorValue(col[0], r, alpha);
+				col[1] = OverlayColorValue(col[1], g, alpha);
+				col[2] = OverlayColorValue(col[2], b, alpha);
 			}
 		}
 	}
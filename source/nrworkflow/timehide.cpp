@@ -5,12 +5,29 @@
 #include <lib_description.h>
 #include "timehide.h"
 #include "res/description/Hnrtoolbox.h"
+#include "misc/print.h"
+#include "misc/utils.h"
+
+/**
+  * Define as 1 to print the number of elements touched, unchanged and
+  * skipped by every TimeHide update together with its duration.
+  */
+#ifndef TIMEHIDE_BENCHMARK
+#define TIMEHIDE_BENCHMARK 0
+#endif
 
 struct THStats;
 
+/**
+  * Maps every element processed by the #THUpdater to a checksum of its
+  * state after it has been processed. Elements that still yield the same
+  * checksum on the next update do not need to be processed again.
+  */
+typedef c4d_apibridge::HashMap<BaseList2D*, UInt32> THRecordTable;
+
 static void THClearDocument(BaseDocument* doc);
 
-static void THProcessDocument(BaseDocument* doc, THStats& stats, Bool first_call=false);
+static void THProcessDocument(BaseDocument* doc, THStats& stats, THRecordTable* records, Bool first_call=false);
 
 static THStats GetStats(BaseSceneHook* hook, BaseDocument* doc);
 
@@ -40,12 +57,19 @@ struct THStats
 
   const THStats* prev;
 
+  /**
+    * The records of the last update. Only owned by the THStats that
+    * is kept between messages, nullptr for temporary THStats.
+    */
+  THRecordTable* records;
+
   /**
     * Creates a new THStats object with default (disabled) values.
     */
   THStats()
   : only_active(false), only_animated(false), force_update(false),
-    tracks_mode(TRACKSMODE_0), preview_min(), preview_max(), prev(nullptr) {
+    tracks_mode(TRACKSMODE_0), preview_min(), preview_max(), prev(nullptr),
+    records(nullptr) {
   }
 
   /**
@@ -93,12 +117,15 @@ struct THStats
 
   /**
     * Copies the data from another THStats object, the :attr:`prev`
-    * attribute is set to nullptr intentionally.
+    * attribute is set to nullptr intentionally and the :attr:`records`
+    * are not copied.
     */
   void CopyFrom(const THStats& other)
   {
+    THRecordTable* own_records = records;
     *this = other;
     prev = nullptr;
+    records = own_records;
   }
 
   Bool operator == (const THStats& other) const
@@ -190,6 +217,125 @@ Bool BranchIterator::RunIteration(GeListNode* root) {
   return true;
 }
 
+/**
+  * Collects the NBIT changes of an iteration and applies them in a
+  * single pass with #Apply(). Only bits that actually differ from the
+  * element's current state are changed, and the last change to a bit
+  * wins. #Get() takes pending changes into account.
+  */
+class THBitBatch
+{
+public:
+
+  /// TimeHide changes at most two ranges of four NBITs per element.
+  static const Int32 MAX_BITS = 8;
+
+  THBitBatch() : m_touched(0), m_unchanged(0) { }
+
+  void Set(BaseList2D* element, NBIT bit, Bool value)
+  {
+    THBitChanges* changes = GetChanges(element);
+    if (!changes) {
+      // Out of memory, fall back to changing the bit immediately.
+      if (element->GetNBit(bit) != value)
+        element->ChangeNBit(bit, value ? NBITCONTROL_SET : NBITCONTROL_CLEAR);
+      return;
+    }
+    for (Int32 i=0; i < changes->count; i++) {
+      if (changes->bits[i] == bit) {
+        changes->values[i] = value;
+        return;
+      }
+    }
+    if (changes->count >= MAX_BITS) {
+      if (element->GetNBit(bit) != value)
+        element->ChangeNBit(bit, value ? NBITCONTROL_SET : NBITCONTROL_CLEAR);
+      return;
+    }
+    changes->bits[changes->count] = bit;
+    changes->values[changes->count] = value;
+    changes->count++;
+  }
+
+  Bool Get(BaseList2D* element, NBIT bit) const
+  {
+    const IndexMap::Entry* entry = m_index.FindEntry(element);
+    if (entry) {
+      const THBitChanges& changes = m_pending[entry->GetValue()];
+      for (Int32 i=0; i < changes.count; i++) {
+        if (changes.bits[i] == bit) return changes.values[i];
+      }
+    }
+    return element->GetNBit(bit);
+  }
+
+  /**
+    * Applies all pending changes and clears the batch. Returns the
+    * number of elements of which at least one NBIT changed.
+    */
+  Int32 Apply()
+  {
+    m_touched = 0;
+    m_unchanged = 0;
+    for (const THBitChanges& changes : m_pending) {
+      Bool touched = false;
+      for (Int32 i=0; i < changes.count; i++) {
+        if (changes.element->GetNBit(changes.bits[i]) != changes.values[i]) {
+          NBITCONTROL control = changes.values[i] ? NBITCONTROL_SET : NBITCONTROL_CLEAR;
+          changes.element->ChangeNBit(changes.bits[i], control);
+          touched = true;
+        }
+      }
+      if (touched) m_touched++;
+      else m_unchanged++;
+    }
+    m_pending.Flush();
+    m_index = IndexMap();
+    return m_touched;
+  }
+
+  /// The number of elements changed by the last #Apply().
+  Int32 GetTouchedCount() const { return m_touched; }
+
+  /// The number of elements that were already up to date in the last #Apply().
+  Int32 GetUnchangedCount() const { return m_unchanged; }
+
+private:
+
+  struct THBitChanges
+  {
+    BaseList2D* element;
+    Int32 count;
+    NBIT bits[MAX_BITS];
+    Bool values[MAX_BITS];
+  };
+
+  typedef c4d_apibridge::HashMap<BaseList2D*, Int> IndexMap;
+
+  THBitChanges* GetChanges(BaseList2D* element)
+  {
+    maxon::Bool created = false;
+    auto entry = m_index.FindOrCreateEntry(element, created);
+    if (!entry) return nullptr;
+    if (!created) return &m_pending[entry->GetValue()];
+
+    iferr (THBitChanges* changes = m_pending.Append()) {
+      m_index = IndexMap();  // Can not remove a single entry, start over.
+      return nullptr;
+    }
+    entry->GetValue() = m_pending.GetCount() - 1;
+    changes->element = element;
+    changes->count = 0;
+    return changes;
+  }
+
+  maxon::BaseArray<THBitChanges> m_pending;
+  IndexMap m_index;
+  Int32 m_touched;
+  Int32 m_unchanged;
+
+};
+
 class THUpdater : public BranchIterator
 {
 
@@ -197,8 +343,22 @@ class THUpdater : public BranchIterator
 
 public:
 
-  THUpdater(const THStats& stats=THStats(), UPDATETYPE type=UPDATETYPE_NORMAL)
-  : super(), m_stats(stats), m_type(type) { }
+  THUpdater(const THStats& stats=THStats(), UPDATETYPE type=UPDATETYPE_NORMAL,
+    const THRecordTable* prev_records=nullptr)
+  : super(), m_stats(stats), m_type(type), m_prev_records(prev_records),
+    m_skipped(0) { }
+
+  /**
+    * Returns the records of the elements processed by the last
+    * iteration.
+    */
+  THRecordTable& GetRecords() { return m_records; }
+
+  /// The number of elements skipped because they did not change.
+  Int32 GetSkippedCount() const { return m_skipped; }
+
+  /// The batch of NBIT changes, applied in Finalize().
+  const THBitBatch& GetBatch() const { return m_batch; }
 
   //| BranchIterator Overrides
 
@@ -210,7 +370,20 @@ public:
       // the UI.
     }
     else if (node->IsInstanceOf(Tbaselist2d)) {
-      SetStates(node, node, m_type);
+      BaseList2D* element = static_cast<BaseList2D*>(node);
+
+      // Elements that did not change since the last update can be
+      // skipped, their NBITs are still up to date.
+      const THRecordTable::Entry* entry = nullptr;
+      if (m_prev_records) entry = m_prev_records->FindEntry(element);
+      if (entry && entry->GetValue() == GetChecksum(element)) {
+        m_records.Put(element, entry->GetValue());
+        m_skipped++;
+      }
+      else {
+        SetStates(node, node, m_type);
+        m_records.Put(element, GetChecksum(element));
+      }
 
       // Skip the Motion System completely.
       if (node->IsInstanceOf(_ID_TAG_MOTIONSYSTEM)) return BRANCHITER_CONTINUE_ELSEWHERE;
@@ -219,8 +392,41 @@ public:
     return BRANCHITER_CONTINUE;
   }
 
+  virtual void Finalize()
+  {
+    m_batch.Apply();
+  }
+
 private:
 
+  /// Computes a checksum of everything that SetStates() takes into
+  /// account for the element: its data, selection state and the
+  /// tracks of the element and its shaders.
+  UInt32 GetChecksum(BaseList2D* element)
+  {
+    UInt32 value = element->GetDirty(DIRTYFLAGS_DATA);
+    value = value * 31 + (element->GetBit(BIT_ACTIVE) ? 1 : 0);
+    for (CTrack* track=element->GetFirstCTrack(); track; track=track->GetNext()) {
+      value = value * 31 + track->GetDirty(DIRTYFLAGS_DATA);
+    }
+    for (BaseShader* shader=element->GetFirstShader(); shader; shader=shader->GetNext()) {
+      value = value * 31 + GetShaderChecksum(shader);
+    }
+    return value;
+  }
+
+  UInt32 GetShaderChecksum(BaseShader* shader)
+  {
+    UInt32 value = shader->GetDirty(DIRTYFLAGS_DATA);
+    for (CTrack* track=shader->GetFirstCTrack(); track; track=track->GetNext()) {
+      value = value * 31 + track->GetDirty(DIRTYFLAGS_DATA);
+    }
+    for (BaseShader* child=shader->GetDown(); child; child=child->GetNext()) {
+      value = value * 31 + GetShaderChecksum(child);
+    }
+    return value;
+  }
+
   void SetStates(GeListNode* dest, GeListNode* reference, UPDATETYPE type)
   {
     SetStates((BaseList2D*) dest, (BaseList2D*) reference, type);
@@ -378,10 +584,9 @@ private:
 
   void SetNBitRange(BaseList2D* dest, NBIT start, Int32 count, Bool mode)
   {
-    NBITCONTROL control = mode ? NBITCONTROL_SET : NBITCONTROL_CLEAR;
     for (Int32 i=0; i < count; i++) {
       NBIT bit = (NBIT) ((Int32) start + i);
-      dest->ChangeNBit(bit, control);
+      m_batch.Set(dest, bit, mode);
     }
   }
 
@@ -391,7 +596,7 @@ private:
     for (Int32 i=0; i < count; i++) {
       Int32 j = sizeof(value) - i - 1;
       NBIT bit = (NBIT) ((Int32) start + i);
-      if (dest->GetNBit(bit)) {
+      if (m_batch.Get(dest, bit)) {
         value |= 1 << j;
       }
     }
@@ -403,17 +608,16 @@ private:
     for (Int32 i=0; i < count; i++) {
       Int32 j = sizeof(value) - i - 1;
       NBIT bit = (NBIT) ((Int32) start + i);
-      if (value & (1 << j)) {
-        dest->ChangeNBit(bit, NBITCONTROL_SET);
-      }
-      else {
-        dest->ChangeNBit(bit, NBITCONTROL_CLEAR);
-      }
+      m_batch.Set(dest, bit, (value & (1 << j)) != 0);
     }
   }
 
   THStats m_stats;
   UPDATETYPE m_type;
+  const THRecordTable* m_prev_records;
+  THRecordTable m_records;
+  THBitBatch m_batch;
+  Int32 m_skipped;
 
 };
 
@@ -427,7 +631,7 @@ void THClearDocument(BaseDocument* doc)
   updater.RunIteration(doc);
 }
 
-void THProcessDocument(BaseDocument* doc, THStats& stats, Bool first_call)
+void THProcessDocument(BaseDocument* doc, THStats& stats, THRecordTable* records, Bool first_call)
 {
   if (doc == nullptr) {
     GePrint("[TimeHide ERROR]: THProcessDocument() without document.");
@@ -440,9 +644,24 @@ void THProcessDocument(BaseDocument* doc, THStats& stats, Bool first_call)
     return;
   }
 
+  // If only the document changed but not the options, only the
+  // elements that changed since the last update need to be processed.
+  Bool incremental = !first_call && records && stats.prev && stats == *stats.prev;
+
+#if TIMEHIDE_BENCHMARK
+  utils::Timer timer;
+#endif
   UPDATETYPE type = first_call ? UPDATETYPE_INIT : UPDATETYPE_NORMAL;
-  THUpdater updater(stats, type);
+  THUpdater updater(stats, type, incremental ? records : nullptr);
   updater.RunIteration(doc);
+  if (records) *records = std::move(updater.GetRecords());
+
+#if TIMEHIDE_BENCHMARK
+  const THBitBatch& batch = updater.GetBatch();
+  print::info("[TimeHide]:", batch.GetTouchedCount(), "elements touched,",
+    batch.GetUnchangedCount(), "unchanged,", updater.GetSkippedCount(),
+    "skipped in", timer.Sum(), "ms");
+#endif
 }
 
 THStats GetStats(BaseSceneHook* hook, BaseDocument* doc, THStats* m_stats)
@@ -476,6 +695,12 @@ THStats* THMessage(THStats* m_stats, BaseSceneHook* hook, BaseDocument* doc, Int
   THStats stats;
   Bool updated = false;
 
+  if (!m_stats) {
+    m_stats = NewObjClear(THStats);
+    if (m_stats) m_stats->records = NewObjClear(THRecordTable);
+  }
+  THRecordTable* records = m_stats ? m_stats->records : nullptr;
+
   switch (msg) {
     case MSG_TIMEHIDE_EVMSG_CHANGE:
     case MSG_DESCRIPTION_POSTSETPARAMETER: {
@@ -489,7 +714,7 @@ THStats* THMessage(THStats* m_stats, BaseSceneHook* hook, BaseDocument* doc, Int
         // EVMSG_CHANGE occured, we need to force the update.
         stats.force_update = true;
       }
-      THProcessDocument(doc, stats);
+      THProcessDocument(doc, stats, records);
 
       if (msg != MSG_TIMEHIDE_EVMSG_CHANGE) {
         EventAdd();
@@ -508,21 +733,19 @@ THStats* THMessage(THStats* m_stats, BaseSceneHook* hook, BaseDocument* doc, Int
         case MSG_DOCUMENTINFO_TYPE_SAVE_BEFORE:
           // Unhide all elements before saving.
           THClearDocument(doc);
+          if (records) *records = THRecordTable();
           break;
         case MSG_DOCUMENTINFO_TYPE_SAVE_AFTER:
         default:
           // Process them respectively in any other case.
           Bool first_call = data->type == MSG_DOCUMENTINFO_TYPE_SAVE_AFTER;
-          THProcessDocument(doc, stats, first_call);
+          THProcessDocument(doc, stats, records, first_call);
           break;
       }
       break;
     }
   }
 
-  if (!m_stats)
-    m_stats = NewObjClear(THStats);
-
   // Update the last stats so they can be compared to check if
   // the next update is actually required.
   if (updated && m_stats) m_stats->CopyFrom(stats);
@@ -531,5 +754,6 @@ THStats* THMessage(THStats* m_stats, BaseSceneHook* hook, BaseDocument* doc, Int
 
 void THFreeStats(THStats*& stats)
 {
-  DeleteMem(stats);
+  if (stats) DeleteObj(stats->records);
+  DeleteObj(stats);
 }
@@ -22,6 +22,72 @@ using niklasrosenstein::c4d::auto_bitmap;
 String* g_msgReachedHierarchyEnd = NULL;
 String* g_msgNoTextureTagAt = NULL;
 
+/**
+ * A compiled instruction-set of DNUPC. The instruction string is
+ * translated once so that resolving the path for an object does not
+ * have to parse it again.
+ */
+class OR_Path {
+
+    maxon::BaseArray<Char> m_ops;
+
+public:
+
+    /**
+     * Compiles the instruction string. Like in the string, the
+     * instructions stop at the first unknown character.
+     */
+    void Compile(const String& expr) {
+        m_ops.Flush();
+        Int32 count = expr.GetLength();
+        for (Int32 i=0; i < count; i++) {
+            Char op;
+            switch (expr[i]) {
+                case 'd': case 'D': op = 'D'; break;
+                case 'n': case 'N': op = 'N'; break;
+                case 'p': case 'P': op = 'P'; break;
+                case 'u': case 'U': op = 'U'; break;
+                case 'c': case 'C': op = 'C'; break;
+                default: return;
+            }
+            iferr (m_ops.Append(op))
+                return;
+        }
+    }
+
+    /**
+     * Resolves the path starting at *op*.
+     */
+    template <typename T>
+    T* Resolve(T* op) const {
+        for (Int32 i=0; op && i < m_ops.GetCount(); i++) {
+            switch (m_ops[i]) {
+                case 'D':
+                    op = op->GetDown();
+                    break;
+                case 'N':
+                    op = op->GetNext();
+                    break;
+                case 'P':
+                    op = op->GetPred();
+                    break;
+                case 'U':
+                    op = op->GetUp();
+                    break;
+                case 'C':
+                    if (op->IsInstanceOf(Obase)) {
+                        BaseObject* cop = static_cast<BaseObject*>(op);
+                        op = cop->GetDeformCache();
+                        if (!op) op = cop->GetCache();
+                    }
+                    break;
+            }
+        }
+        return op;
+    }
+
+};
+
 /**
  * Structure containing all transformation information for the
  * offset transformation process.
@@ -53,14 +119,18 @@ struct OR_Data {
     Vector rotationMin;
     Vector rotationMax;
 
-    Char* startexpr;
-    Char* nextexpr;
-    Char* execexpr;
+    OR_Path startexpr;
+    OR_Path nextexpr;
+    OR_Path execexpr;
 
     // OUT
 
     Int32 tagsAffected;
 
+    // The texture tags collected by the master and all its slaves, in
+    // the order they are randomized in.
+    maxon::BaseArray<TextureTag*> targets;
+
     OR_Data() {
         initialized = FALSE;
     }
@@ -95,35 +165,18 @@ struct OR_Data {
         rotationMin = bc->GetVector(OFFSETRANDOMIZER_ROTATION_MIN);
         rotationMax = bc->GetVector(OFFSETRANDOMIZER_ROTATION_MAX);
 
-        String _start = bc->GetString(OFFSETRANDOMIZER_STARTEXPR);
-        String _next = bc->GetString(OFFSETRANDOMIZER_NEXTEXPR);
-        String _exec = bc->GetString(OFFSETRANDOMIZER_EXECEXPR);
-        startexpr = _start.GetCStringCopy();
-        nextexpr = _next.GetCStringCopy();
-        execexpr = _exec.GetCStringCopy();
+        startexpr.Compile(bc->GetString(OFFSETRANDOMIZER_STARTEXPR));
+        nextexpr.Compile(bc->GetString(OFFSETRANDOMIZER_NEXTEXPR));
+        execexpr.Compile(bc->GetString(OFFSETRANDOMIZER_EXECEXPR));
 
         tagsAffected = 0;
+        targets.Flush();
 
         initialized = offsetEnabled || scaleEnabled || rotationEnabled
                    || uvwOffEnabled || uvwScaleEnabled;
         return initialized;
     }
 
-    void Free() {
-        if (startexpr) {
-            DeleteMem(startexpr);
-            startexpr = NULL;
-        }
-        if (nextexpr) {
-            DeleteMem(nextexpr);
-            nextexpr = NULL;
-        }
-        if (execexpr) {
-            DeleteMem(execexpr);
-            execexpr = NULL;
-        }
-    }
-
     Vector RandomInRange(Vector min, Vector max) {
         Float x = random.Get01();
         Float y = random.Get01();
@@ -156,6 +209,8 @@ public:
 
     EXECUTIONRESULT PerformExecution(BaseTag* tag, BaseObject* host, OR_Data* data);
 
+    void ApplyTargets(OR_Data* data);
+
     //| TagData Overrides
 
     EXECUTIONRESULT Execute(BaseTag* tag, BaseDocument* doc, BaseObject* host,
@@ -181,46 +236,6 @@ public:
 
 // ----------------------------------------------------------------------------
 
-/**
- * Exexutes an instruction-set of DNUPC.
- */
-template <typename T>
-T* ExecuteInstructions(const Char* p, T* op, Bool allowNull=FALSE) {
-    if (!p && !allowNull) return NULL;
-    while(op && p && *p) {
-        switch (*(p++)) {
-            case 'd':
-            case 'D':
-                op = op->GetDown();
-                break;
-            case 'n':
-            case 'N':
-                op = op->GetNext();
-                break;
-            case 'p':
-            case 'P':
-                op = op->GetPred();
-                break;
-            case 'u':
-            case 'U':
-                op = op->GetUp();
-                break;
-            case 'c':
-            case 'C':
-                if (op->IsInstanceOf(Obase)) {
-                    BaseObject* cop = static_cast<BaseObject*>(op);
-                    op = cop->GetDeformCache();
-                    if (!op) op = cop->GetCache();
-                }
-                break;
-            default:
-                p = NULL;
-                break;
-        }
-    }
-    return op;
-}
-
 void HideDescParameter(Description* desc, const DescID& parameter, Bool hidden=TRUE) {
     if (!desc) return;
     BaseContainer* item = desc->GetParameterI(parameter, NULL);
@@ -285,11 +300,12 @@ void OffsetRandomizer::RunProcessing(BaseTag* tag, BaseObject* host, Int32 mode,
 
     Int32 tagIndex = bc->GetInt32(OFFSETRANDOMIZER_TAGINDEX);
     if (data->initialized) {
-        // Retrieve the object iteration should start from.
-        BaseObject* op = ExecuteInstructions(data->startexpr, host);
+        // Retrieve the object iteration should start from. The texture
+        // tags are only collected here, see ApplyTargets().
+        BaseObject* op = data->startexpr.Resolve(host);
         while (op) {
             // Retrieve the object the execution should be performed on.
-            BaseObject* exec = ExecuteInstructions(data->execexpr, op, TRUE);
+            BaseObject* exec = data->execexpr.Resolve(op);
             if (exec) {
                 // Find the texture-tag and execute all sub Offset
                 // randomizer tags. This is necessary for nested
@@ -300,16 +316,19 @@ void OffsetRandomizer::RunProcessing(BaseTag* tag, BaseObject* host, Int32 mode,
                     // Is it a texture tag?
                     if (modify_tags && tag->IsInstanceOf(Ttexture)) {
                         if (ttindex == tagIndex) {
-                            ModifyTag(static_cast<TextureTag*>(tag), *data);
+                            iferr (data->targets.Append(static_cast<TextureTag*>(tag)))
+                                return;
                             tagsAffected++;
                             data->tagsAffected++;
                         }
                         ttindex++;
                     }
 
-                    // Is it an Offset Randomizer tag?
+                    // Is it an Offset Randomizer tag? Collect its texture
+                    // tags directly instead of sending it a message.
                     else if (execute_subs && tag->IsInstanceOf(Toffsetrandomizer)) {
-                        tag->Message(MSG_OFFSETRANDOMIZER_SUBEXECUTION, data);
+                        OffsetRandomizer* sub = tag->GetNodeData<OffsetRandomizer>();
+                        if (sub) sub->PerformExecution(tag, tag->GetObject(), data);
                     }
 
                     tag = tag->GetNext();
@@ -319,13 +338,21 @@ void OffsetRandomizer::RunProcessing(BaseTag* tag, BaseObject* host, Int32 mode,
             // Retrieve the next object. If the returned object is equal to
             // the current one, we stop here because that would lead to an
             // infinite loop.
-            BaseObject* next = ExecuteInstructions(data->nextexpr, op);
+            BaseObject* next = data->nextexpr.Resolve(op);
             if (next == op) next = NULL;
             op = next;
         }
     }
 }
 
+void OffsetRandomizer::ApplyTargets(OR_Data* data) {
+    if (!data) return;
+    for (Int32 i=0; i < data->targets.GetCount(); i++) {
+        ModifyTag(data->targets[i], *data);
+    }
+    data->targets.Flush();
+}
+
 EXECUTIONRESULT OffsetRandomizer::PerformExecution(BaseTag* tag, BaseObject* host, OR_Data* data) {
     if (!tag || !host || !data) return EXECUTIONRESULT_OUTOFMEMORY;
 
@@ -405,7 +432,9 @@ EXECUTIONRESULT OffsetRandomizer::Execute(BaseTag* tag, BaseDocument* doc, BaseO
     Int32 mode = bc->GetInt32(OFFSETRANDOMIZER_MODE);
     if (mode == OFFSETRANDOMIZER_MODE_NORMAL || mode == OFFSETRANDOMIZER_MODE_MASTER) {
         OR_Data data;
-        return PerformExecution(tag, host, &data);
+        EXECUTIONRESULT result = PerformExecution(tag, host, &data);
+        ApplyTargets(&data);
+        return result;
     }
     return EXECUTIONRESULT_OK;
 }
@@ -415,6 +444,7 @@ Bool OffsetRandomizer::Message(GeListNode* node, Int32 type, void* pData) {
         BaseTag* tag = static_cast<BaseTag*>(node);
         OR_Data* data = static_cast<OR_Data*>(pData);
         if (tag && data) {
+            // The collected texture tags are modified by the sender.
             PerformExecution(tag, tag->GetObject(), data);
             return TRUE;
         }
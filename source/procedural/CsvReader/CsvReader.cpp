@@ -5,7 +5,7 @@
 /// \lastmodified 2015/07/10
 
 #include <c4d_apibridge.h>
-#include "fs.hpp"
+#include "csvcache.hpp"
 #include "CsvReader.h"
 #include "DescriptionHelper.h"
 #include "res/description/nrprocedural_csvreader.h"
@@ -50,17 +50,25 @@ namespace nr {
 }
 
 /*!
- * Helper class for working with CSV files that eventually need to be
- * reloaded at a later point in the program.
+ * A CSV table that is loaded through the @csvcache and shared between
+ * all CSV Reader tags that read the same file.
  */
-class csv_table
+class csv_table : public csvcache::table
 {
 public:
   using csv_row = nr::csv_row;
 
-  /* Default constructor. Sets @delim to {','} and @quote to {'"'}. */
+  /* Default constructor. Creates an empty table. */
   csv_table() : info_() { this->clear(); }
 
+  /* Load the table for the specified cache @key. */
+  explicit csv_table(csvcache::key const& key) : info_()
+  {
+    this->clear();
+    this->info_.delim = key.delim;
+    this->load(key.path);
+  }
+
   /* Destructor. */
   ~csv_table() { }
 
@@ -83,46 +91,21 @@ public:
   /* Return the length of the largest row in the table. */
   size_t row_max() const { return this->rowmax_; }
 
-  /* Get/set the delimiter. */
-  char& delim() { return this->info_.delim; }
-
-  /* Get/set the quote. */
-  char& quote() { return this->info_.quote; }
+  /* Returns true if the file could be read. */
+  bool loaded() const { return this->loaded_; }
 
   /* Flush the table data. */
   void clear()
   {
     this->loaded_ = false;
-    this->file_ = "";
-    this->ftime_ = 0;
     this->rowmin_ = 0;
     this->rowmax_ = 0;
     this->rows_.clear();
   }
 
-  /*!
-   * Initialize the table with the specified @file name. If the name
-   * or filetime didn't change, the table is not reloaded. If the file
-   * no longer exists, the table is cleared.
-   */
-  bool init(std::string const& file, bool force_reload = false, bool* reloaded = nullptr)
+  /* Flush the table and read the specified @file. */
+  bool load(std::string const& file)
   {
-    if (reloaded) *reloaded = false;
-
-    // Check if we need to reload the file.
-    if (!force_reload && file == this->file_) {
-      uint64_t ftime = fs::getmtime(file);
-      if (ftime == this->ftime_) {
-        return true;
-      }
-      this->ftime_ = ftime;
-    }
-    else {
-      this->file_ = file;
-      this->ftime_ = fs::getmtime(file);
-    }
-
-    // Flush and reload the CSV data.
     this->clear();
     FILE* fp = fopen(file.c_str(), "r");
     if (!fp) {
@@ -138,17 +121,28 @@ public:
       return true;
     };
     nr::csv_parse(fp, callback, this->info_);
+    fclose(fp);
 
-    if (reloaded) *reloaded = true;
     this->loaded_ = true;
     return true;
   }
 
+  /* csvcache::table overrides */
+
+  size_t memory_usage() const override
+  {
+    size_t bytes = sizeof(*this) + this->rows_.capacity() * sizeof(csv_row);
+    for (auto const& row : this->rows_) {
+      bytes += row.capacity() * sizeof(std::string);
+      for (auto const& cell : row)
+        bytes += cell.capacity();
+    }
+    return bytes;
+  }
+
 private:
 
   bool loaded_;
-  std::string file_;
-  uint64_t ftime_;
   size_t rowmin_, rowmax_;
   std::vector<csv_row> rows_;
   nr::csv_info info_;
@@ -466,7 +460,7 @@ public:
   static NodeData* Alloc() { return NewObjClear(CsvReaderPlugin); }
 
   CsvReaderPlugin()
-    : m_reloadDcount(), m_cycleDcount(), m_cycleContainer(), m_table() { }
+    : m_reloadDcount(), m_cycleDcount(), m_cycleContainer(), m_table(), m_empty() { }
 
   inline BaseTag* Get() { return static_cast<BaseTag*>(SUPER::Get()); }
   inline BaseTag* Get(GeListNode* node) { return static_cast<BaseTag*>(node); }
@@ -518,8 +512,10 @@ private:
   Int32 m_cycleDcount;
   /// This container will hold the drop-down options.
   BaseContainer m_cycleContainer;
-  /// This data structure reads a CSV file and stores it in memory.
-  csv_table m_table;
+  /// The CSV table shared through the csvcache, may be null.
+  std::shared_ptr<csv_table const> m_table;
+  /// Used in place of \var m_table if no table is loaded.
+  csv_table m_empty;
 };
 
 /// **************************************************************************
@@ -533,7 +529,7 @@ void CsvReaderPlugin::UpdateTable(BaseTag* op, Bool forceRefresh)
   goto main;
 
 cleanup:
-  m_table.clear();
+  m_table.reset();
   m_cycleContainer.FlushAll();
   m_cycleContainer.SetString(0, "---"_s);
   op->SetDirty(DIRTYFLAGS_DESCRIPTION);
@@ -560,11 +556,22 @@ main:
     goto cleanup;
   }
 
-  bool didReload = false;
+  // The table is shared with all other tags that read the same file.
+  // The header is not part of the key as it is stored as the first row.
   Int32 start = GeGetMilliSeconds();
-
-  bool success = m_table.init(std::to_string(dfn.GetString()), forceRefresh, &didReload);
-  print::info("Parsed CSV table in " + tostr(Float(GeGetMilliSeconds() - start) / 1000.0) + "s (%d rows)", (Int32)m_table.row_count());
+  csvcache::key const key = csvcache::make_key(
+    "procedural.csv_table", std::to_string(dfn.GetString()), ',', false);
+  std::shared_ptr<csv_table const> table = csvcache::acquire<csv_table>(key, forceRefresh);
+  if (!table) {
+    this->SetStatus(op, "Memory Error.");
+    goto cleanup;
+  }
+  bool const didReload = table != m_table;
+  bool const success = table->loaded();
+  m_table = table;
+  if (didReload) {
+    print::info("Loaded CSV table in " + tostr(Float(GeGetMilliSeconds() - start) / 1000.0) + "s (%d rows)", (Int32)m_table->row_count());
+  }
 
   Bool rebuildContainer = false;
   dcount = hasHeader;
@@ -577,9 +584,9 @@ main:
     /*if (!success)
       message = "Error (" + tostr(m_table.GetLastError());
     else*/
-    message = "Loaded. Rows: " + tostr((UInt) m_table.row_count()) +
-    " Min Cols: " + tostr((UInt) m_table.row_min()) +
-    " Max Cols: " + tostr((UInt) m_table.row_max());
+    message = "Loaded. Rows: " + tostr((UInt) m_table->row_count()) +
+    " Min Cols: " + tostr((UInt) m_table->row_min()) +
+    " Max Cols: " + tostr((UInt) m_table->row_max());
     this->SetStatus(op, message);
   }
 
@@ -587,9 +594,9 @@ main:
     m_cycleContainer.FlushAll();
     m_cycleContainer.SetString(0, "---"_s);
     if (success) {
-      if (m_table.row_count() > 0) {
-        csv_table::csv_row const& header = m_table.row(0);
-        for (Int32 index = 0; index < m_table.row_max(); ++index) {
+      if (m_table->row_count() > 0) {
+        csv_table::csv_row const& header = m_table->row(0);
+        for (Int32 index = 0; index < m_table->row_max(); ++index) {
           String name = (hasHeader && index < header.size() ? tostr(header[index]) : tostr(index));
           m_cycleContainer.SetString(index + 1, name);
         }
@@ -622,7 +629,7 @@ EXECUTIONRESULT CsvReaderPlugin::Execute(
     const Int32 count = this->GetEntryCount(tag);
     for (Int32 index = 0; index < count; ++index) {
       CsvEntry entry(index);
-      entry.Update(tag, m_table);
+      entry.Update(tag, m_table ? *m_table : m_empty);
     }
   }
   return EXECUTIONRESULT_OK;
@@ -18,6 +18,84 @@
 // ===== TvNode implementation ===============================================
 // ===========================================================================
 
+#define TV_ACCEPTPARENT     (1 << 0)
+#define TV_ACCEPTCHILD      (1 << 1)
+
+/**
+ * @return true if *node* is registered with TVPLUGIN_STATICCONTEXT.
+ */
+static Bool TvHasStaticContext(TvNode* node) {
+    const TVPLUGIN* plug = TvRetrieveTableX<TVPLUGIN>(node);
+    return plug && (plug->info & TVPLUGIN_STATICCONTEXT);
+}
+
+static inline UInt64 TvMixKey(UInt64 key, UInt64 value) {
+    return (key ^ value) * 1099511628211ULL;
+}
+
+/**
+ * Computes the key of everything the acceptance checks between *node*
+ * and its children depend on: the data dirty counts of the node and its
+ * children, the identities of the children in order and, if the node
+ * does not have a static context, the parents up to the first one that
+ * has. Changes further down in the subtree are not part of the key,
+ * they reset the cached result with TvNode::InvalidateContextSafety().
+ */
+static UInt64 TvValidateKey(TvNode* node) {
+    UInt64 key = TvMixKey(14695981039346656037ULL, node->GetDirty(DIRTYFLAGS_DATA));
+    TvNode* child = node->GetDown();
+    while (child) {
+        key = TvMixKey(key, (UInt64) child->GetGUID());
+        key = TvMixKey(key, child->GetDirty(DIRTYFLAGS_DATA));
+        child = child->GetNext();
+    }
+    TvNode* parent = node;
+    while (!TvHasStaticContext(parent) && (parent = parent->GetUp())) {
+        key = TvMixKey(key, (UInt64) parent->GetGUID());
+        key = TvMixKey(key, parent->GetDirty(DIRTYFLAGS_DATA));
+    }
+    return key;
+}
+
+/**
+ * The results of TvCheckAccept() for all combinations of plugin types
+ * with a static context that have been checked so far. Freed with
+ * TvFreeAcceptMatrix().
+ */
+static c4d_apibridge::HashMap<Int64, Int32> g_acceptMatrix;
+
+void TvFreeAcceptMatrix() {
+    g_acceptMatrix.Reset();
+}
+
+/**
+ * Checks if *child* accepts *parent* as its parent and if *parent*
+ * accepts *child* as its child. If both nodes have a static context,
+ * the result only depends on their plugin types and is stored in
+ * #g_acceptMatrix.
+ *
+ * @return A combination of TV_ACCEPTPARENT and TV_ACCEPTCHILD.
+ */
+static Int32 TvCheckAccept(TvNode* parent, TvNode* child) {
+    Bool useMatrix = TvHasStaticContext(parent) && TvHasStaticContext(child);
+    Int64 key = ((Int64) parent->GetType() << 32) | (UInt32) child->GetType();
+    if (useMatrix) {
+        auto entry = g_acceptMatrix.FindEntry(key);
+        if (entry) return entry->GetValue();
+    }
+
+    Int32 result = 0;
+    if (child->AcceptParent(parent)) result |= TV_ACCEPTPARENT;
+    if (parent->AcceptChild(child)) result |= TV_ACCEPTCHILD;
+
+    if (useMatrix) {
+        maxon::Bool created = false;
+        auto entry = g_acceptMatrix.FindOrCreateEntry(key, created);
+        if (entry) entry->GetValue() = result;
+    }
+    return result;
+}
+
 BaseList2D* TvNode::Execute(TvNode* root, BaseList2D* context) {
     TvOperatorData* data = TvGetNodeData<TvOperatorData>(this);
     const TVPLUGIN* plug = TvRetrieveTableX<TVPLUGIN>(data);
@@ -30,6 +108,12 @@ Bool TvNode::AskCondition(TvNode* root, BaseList2D* context) {
     return (data->*plug->AskCondition)(this, root, context);
 }
 
+Bool TvNode::Compile(TvPlan* plan) {
+    TvOperatorData* data = TvGetNodeData<TvOperatorData>(this);
+    const TVPLUGIN* plug = TvRetrieveTableX<TVPLUGIN>(data);
+    return (data->*plug->Compile)(this, plan);
+}
+
 Bool TvNode::PredictContextType(Int32 type) {
     TvOperatorData* data = TvGetNodeData<TvOperatorData>(this);
     const TVPLUGIN* plug = TvRetrieveTableX<TVPLUGIN>(data);
@@ -112,6 +196,7 @@ void TvNode::SetEnabled(Bool enabled) {
     BaseContainer* data = GetDataInstance();
     if (!data) return;
     data->SetBool(TVBASE_ENABLED, enabled);
+    InvalidateContextSafety();
 }
 
 Bool TvNode::IsInverted() const {
@@ -181,19 +266,27 @@ TvNode* TvNode::ValidateContextSafety(TvNode* newParent, Bool checkRemoval) {
                 return this;
             }
         }
-        if (!AcceptParent(newParent)) {
+
+        Int32 accept = TvCheckAccept(newParent, this);
+        if (!(accept & TV_ACCEPTPARENT)) {
             #ifdef VERBOSE
             GePrint(pre + GetName() + dna + newParent->GetName() + tAp);
             #endif
             return this;
         }
-        if (!newParent->AcceptChild(this)) {
+        if (!(accept & TV_ACCEPTCHILD)) {
             #ifdef VERBOSE
             GePrint(pre + newParent->GetName() + dna + GetName() + tAc);
             #endif
             return this;
         }
 
+        // The child-nodes of a node with a static context can not
+        // depend on the parents of the node, no need to move it.
+        if (TvHasStaticContext(this)) {
+            return ValidateContextSafety(nullptr);
+        }
+
         Remove();
         InsertUnder(newParent);
 
@@ -203,20 +296,45 @@ TvNode* TvNode::ValidateContextSafety(TvNode* newParent, Bool checkRemoval) {
         else if (parent) InsertUnder(parent);
     }
     else {
+        // The whole subtree is skipped if it passed before and nothing
+        // it depends on changed since. Changes to the node, its children
+        // and its parents change the key, changes further down reset
+        // the result (see InvalidateContextSafety()).
+        TvOperatorData* data = TvGetNodeData<TvOperatorData>(this);
+        UInt64 key = TvValidateKey(this);
+        if (data && data->validateAccepted && data->validateKey == key) {
+            return nullptr;
+        }
+
         TvNode* child = GetDown();
         while (child) {
-            if (!child->AcceptParent(this)) {
-                return child;
+            if (TvCheckAccept(this, child) != (TV_ACCEPTPARENT | TV_ACCEPTCHILD)) {
+                failedAt = child;
+                break;
             }
-            if (!AcceptChild(child)) return child;
             failedAt = child->ValidateContextSafety(nullptr, false);
             if (failedAt) break;
             child = child->GetNext();
         }
+
+        // Only remember the checks if all children have been checked.
+        if (data) {
+            data->validateAccepted = !failedAt;
+            data->validateKey = key;
+        }
     }
     return failedAt;
 }
 
+void TvNode::InvalidateContextSafety() {
+    TvNode* node = this;
+    while (node) {
+        TvOperatorData* data = TvGetNodeData<TvOperatorData>(node);
+        if (data) data->validateAccepted = false;
+        node = node->GetUp();
+    }
+}
+
 TvNode* TvNode::Alloc(Int32 typeId) {
     BaseList2D* bl = (BaseList2D*) AllocListNode(typeId);
     if (!bl) return nullptr;
@@ -247,6 +365,11 @@ Bool TvOperatorData::AskCondition(TvNode* host, TvNode* root, BaseList2D* contex
     return false;
 }
 
+Bool TvOperatorData::Compile(TvNode* host, TvPlan* plan) {
+    if (!host || !plan) return false;
+    return plan->AddExecute(host);
+}
+
 Bool TvOperatorData::PredictContextType(TvNode* host, Int32 type) {
     return false;
 }
@@ -358,8 +481,10 @@ Bool TvOperatorData::IsInstanceOf(const GeListNode* node, Int32 type) const {
 Bool TvOperatorData::Message(GeListNode* node, Int32 type, void* pData) {
     switch (type) {
         case MSG_DESCRIPTION_POSTSETPARAMETER:
+            // The parents of the node can not see that it changed.
+            ((TvNode*) node)->InvalidateContextSafety();
             // Notify the tree-view that something has changed.
-            SpecialEventAdd(MSG_TEAPRESSO_UPDATETREEVIEW);
+            TvUpdateTreeViews();
             break;
         case MSG_DESCRIPTION_COMMAND:
             if (!pData) break;
@@ -387,6 +512,371 @@ Bool TvOperatorData::GetDEnabling(
 }
 
 
+// ===========================================================================
+// ===== TvPlan implementation ===============================================
+// ===========================================================================
+
+// Loops with less elements are not worth to be run in parallel.
+static const Int32 TVPLAN_PARALLEL_MINCOUNT = 512;
+
+// Minimum number of elements evaluated by a single thread.
+static const Int32 TVPLAN_PARALLEL_MINSLICE = 256;
+
+/**
+ * @return true if *node* and all of its child-nodes are
+ * TVPLUGIN_READONLY.
+ */
+static Bool TvIsReadOnly(TvNode* node) {
+    const TVPLUGIN* plug = TvRetrieveTableX<TVPLUGIN>(node);
+    if (!plug || !(plug->info & TVPLUGIN_READONLY)) return false;
+    TvNode* child = node->GetDown();
+    while (child) {
+        if (!TvIsReadOnly(child)) return false;
+        child = child->GetNext();
+    }
+    return true;
+}
+
+/**
+ * @return true if *node* and all of its child-nodes are
+ * TVPLUGIN_READONLY or TVPLUGIN_KEEPSCONTEXT.
+ */
+static Bool TvKeepsContext(TvNode* node) {
+    const TVPLUGIN* plug = TvRetrieveTableX<TVPLUGIN>(node);
+    if (!plug || !(plug->info & (TVPLUGIN_READONLY | TVPLUGIN_KEEPSCONTEXT))) return false;
+    TvNode* child = node->GetDown();
+    while (child) {
+        if (!TvKeepsContext(child)) return false;
+        child = child->GetNext();
+    }
+    return true;
+}
+
+Bool TvPlan::Append(Int32 op, TvNode* node) {
+    Instruction ins;
+    ClearMem(&ins, sizeof(ins));
+    ins.op = op;
+    ins.node = node;
+    ins.jump = NOTOK;
+    if (node) {
+        ins.data = TvGetNodeData<TvOperatorData>(node);
+        if (!ins.data) return false;
+        const TVPLUGIN* plug = TvRetrieveTableX<TVPLUGIN>(ins.data);
+        ins.execute = plug->Execute;
+        ins.askCondition = plug->AskCondition;
+        ins.readOnly = TvIsReadOnly(node);
+        ins.keepsContext = TvKeepsContext(node);
+    }
+    iferr (code.Append(ins)) return false;
+    return true;
+}
+
+BaseList2D* TvPlan::Run(Int32 begin, Int32 end, TvNode* root,
+                        BaseList2D* context) const {
+    Int32 pc = begin;
+    while (pc < end) {
+        const Instruction& ins = code[pc];
+        switch (ins.op) {
+            case OP_EXECUTE:
+                context = (ins.data->*ins.execute)(ins.node, root, context);
+                if (!context) return nullptr;
+                pc++;
+                break;
+            case OP_CONDITION:
+                if ((ins.data->*ins.askCondition)(ins.node, root, context))
+                    pc++;
+                else
+                    pc = ins.jump;
+                break;
+            case OP_JUMP:
+                pc = ins.jump;
+                break;
+            case OP_LOOP: {
+                // The loop body follows the loop instruction and ends
+                // at the jump target.
+                if (ins.parallel && RunParallel(pc, root, context)) {
+                    pc = ins.jump;
+                    break;
+                }
+                TvNode* bodyRoot = ins.setRoot ? ins.node : root;
+                BaseList2D* element = ins.iterator->First(context);
+                while (element) {
+                    BaseList2D* result = Run(pc + 1, ins.jump, bodyRoot, element);
+                    element = ins.iterator->Next(element, result);
+                }
+                pc = ins.jump;
+                break;
+            }
+            default:
+                return context;
+        }
+    }
+    return context;
+}
+
+Bool TvPlan::Evaluate(Int32 begin, Int32 end, TvNode* root,
+                      BaseList2D* element, Int32 index,
+                      maxon::BaseArray<Deferred>& deferred) const {
+    BaseList2D* context = element;
+    Int32 pc = begin;
+    while (pc < end) {
+        const Instruction& ins = code[pc];
+        switch (ins.op) {
+            case OP_EXECUTE:
+                if (ins.readOnly) {
+                    if (!(ins.data->*ins.execute)(ins.node, root, context))
+                        return true;
+                }
+                else {
+                    Deferred d = {index, pc};
+                    iferr (deferred.Append(d)) return false;
+                }
+                pc++;
+                break;
+            case OP_CONDITION:
+                if ((ins.data->*ins.askCondition)(ins.node, root, context))
+                    pc++;
+                else
+                    pc = ins.jump;
+                break;
+            case OP_JUMP:
+                pc = ins.jump;
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+struct TvPlan::Slice {
+    const TvPlan* plan;
+    Int32 begin;
+    Int32 end;
+    TvNode* root;
+    BaseList2D* const* elements;
+    Int32 start;
+    Int32 stop;
+    maxon::BaseArray<Deferred> deferred;
+    Bool success;
+};
+
+class TvPlan::SliceThread : public C4DThread {
+
+    Slice& slice;
+
+public:
+
+    SliceThread(Slice& slice) : C4DThread(), slice(slice) { }
+
+    /* Override: C4DThread */
+    void Main() {
+        EvaluateSlice(slice);
+    }
+
+    /* Override: C4DThread */
+    const Char* GetThreadName() {
+        return "TeaPresso-SliceThread";
+    }
+
+};
+
+void TvPlan::EvaluateSlice(Slice& slice) {
+    slice.success = true;
+    for (Int32 j = slice.start; j < slice.stop && slice.success; j++) {
+        slice.success = slice.plan->Evaluate(slice.begin, slice.end, slice.root,
+                                             slice.elements[j], j, slice.deferred);
+    }
+}
+
+Bool TvPlan::RunParallel(Int32 loop, TvNode* root, BaseList2D* context) const {
+    const Instruction& ins = code[loop];
+    TvNode* bodyRoot = ins.setRoot ? ins.node : root;
+
+    // The loop body keeps its context and does not change the elements
+    // (see EndLoop()), so they can be gathered up front.
+    maxon::BaseArray<BaseList2D*> elements;
+    BaseList2D* element = ins.iterator->First(context);
+    while (element) {
+        iferr (elements.Append(element)) return false;
+        element = ins.iterator->Next(element, element);
+    }
+
+    Int32 count = (Int32) elements.GetCount();
+    if (count < TVPLAN_PARALLEL_MINCOUNT) return false;
+
+    Int32 cpuCount = GeGetCurrentThreadCount();
+    Int32 threadCount = count / TVPLAN_PARALLEL_MINSLICE;
+    if (threadCount > cpuCount) threadCount = cpuCount;
+    if (threadCount < 2) return false;
+    Int32 sliceCount = (count + threadCount - 1) / threadCount;
+
+    maxon::BaseArray<Slice> slices;
+    iferr (slices.Resize(threadCount)) return false;
+    for (Int32 i = 0; i < threadCount; i++) {
+        Slice& slice = slices[i];
+        slice.plan = this;
+        slice.begin = loop + 1;
+        slice.end = ins.jump;
+        slice.root = bodyRoot;
+        slice.elements = elements.GetFirst();
+        slice.start = i * sliceCount;
+        slice.stop = slice.start + sliceCount;
+        if (slice.stop > count) slice.stop = count;
+        slice.success = false;
+    }
+
+    // Evaluate the conditions of the loop body for all elements. The
+    // expressions that would be executed are only recorded, nothing
+    // has been modified when this pass fails. The first slice is
+    // evaluated on the current thread, as are slices for which no
+    // thread could be started. Space for all threads is reserved before
+    // the first one starts, so a running thread is always tracked and
+    // joined, and a slice is never evaluated twice.
+    {
+        maxon::BaseArray<SliceThread*> threads;
+        iferr (threads.EnsureCapacity(threadCount)) return false;
+        for (Int32 i = 1; i < threadCount; i++) {
+            SliceThread* thread = NewObjClear(SliceThread, slices[i]);
+            Bool started = false;
+            if (thread) {
+                Bool tracked = true;
+                iferr (threads.Append(thread)) tracked = false;
+                if (tracked) started = thread->Start();
+                if (!started) {
+                    if (tracked) threads.Pop();
+                    DeleteObj(thread);
+                }
+            }
+            if (!started) EvaluateSlice(slices[i]);
+        }
+        EvaluateSlice(slices[0]);
+        for (SliceThread* thread : threads) {
+            thread->Wait(false);
+            DeleteObj(thread);
+        }
+    }
+
+    for (const Slice& slice : slices) {
+        if (!slice.success) return false;
+    }
+
+    // Apply the recorded expressions in element order. The slices are
+    // consecutive, so they are ordered already.
+    for (const Slice& slice : slices) {
+        Int32 current = NOTOK;
+        BaseList2D* cContext = nullptr;
+        for (const Deferred& d : slice.deferred) {
+            if (d.element != current) {
+                current = d.element;
+                cContext = elements[current];
+            }
+            if (!cContext) continue;
+            const Instruction& op = code[d.pc];
+            cContext = (op.data->*op.execute)(op.node, bodyRoot, cContext);
+        }
+    }
+    return true;
+}
+
+Bool TvPlan::Compile(TvNode* node) {
+    Flush();
+    if (!node) return false;
+    if (node->ValidateContextSafety(nullptr)) return false;
+    if (!node->Compile(this)) {
+        Flush();
+        return false;
+    }
+    return true;
+}
+
+void TvPlan::Flush() {
+    code.Flush();
+}
+
+Bool TvPlan::AddExecute(TvNode* node) {
+    if (!node) return false;
+    return Append(OP_EXECUTE, node);
+}
+
+Bool TvPlan::AddChildren(TvNode* node) {
+    if (!node) return false;
+    TvNode* child = node->GetDown();
+    while (child) {
+        if (!child->Compile(this)) return false;
+        child = child->GetNext();
+    }
+    return true;
+}
+
+Int32 TvPlan::BeginLoop(TvNode* node, const TvIterator* iterator, Bool setRoot) {
+    if (!node || !iterator) return NOTOK;
+    if (!Append(OP_LOOP, node)) return NOTOK;
+    Instruction& ins = code[code.GetCount() - 1];
+    ins.iterator = iterator;
+    ins.setRoot = setRoot;
+    return GetCount() - 1;
+}
+
+void TvPlan::EndLoop(Int32 loop) {
+    if (loop < 0 || loop >= GetCount()) return;
+    code[loop].jump = GetCount();
+
+    // The loop can be run in parallel if the conditions in its body
+    // are read-only and can be evaluated before any other expression
+    // of the body is applied, and if no expression changes the context
+    // that the iterator continues from.
+    Bool hasCondition = false;
+    Bool hasDeferred = false;
+    Bool parallel = true;
+    for (Int32 i = loop + 1; i < GetCount() && parallel; i++) {
+        const Instruction& ins = code[i];
+        switch (ins.op) {
+            case OP_CONDITION:
+                hasCondition = true;
+                parallel = ins.readOnly && !hasDeferred;
+                break;
+            case OP_EXECUTE:
+                if (!ins.keepsContext) parallel = false;
+                else if (!ins.readOnly) hasDeferred = true;
+                else if (hasDeferred) parallel = false;
+                break;
+            case OP_JUMP:
+                break;
+            default:
+                parallel = false;
+                break;
+        }
+    }
+    code[loop].parallel = parallel && hasCondition;
+}
+
+Int32 TvPlan::BeginCondition(TvNode* node) {
+    if (!node) return NOTOK;
+    if (!Append(OP_CONDITION, node)) return NOTOK;
+    return GetCount() - 1;
+}
+
+Bool TvPlan::Else(Int32 condition) {
+    if (condition < 0 || condition >= GetCount()) return false;
+    if (!Append(OP_JUMP, nullptr)) return false;
+    code[condition].jump = GetCount();
+    return true;
+}
+
+void TvPlan::EndCondition(Int32 condition) {
+    if (condition < 0 || condition >= GetCount()) return;
+    Instruction& ins = code[condition];
+    if (ins.jump == NOTOK) {
+        ins.jump = GetCount();
+    }
+    else {
+        // The instruction before the alternative branch jumps over it.
+        code[ins.jump - 1].jump = GetCount();
+    }
+}
+
+
 // ===========================================================================
 // ===== Library Wrapper implementation ======================================
 // ===========================================================================
@@ -36,6 +36,34 @@
     #define TVPLUGIN_EXPRESSION         (1 << 0)
     #define TVPLUGIN_CONDITION          (1 << 1)
 
+    /**
+     * Declares that the Execute() and AskCondition() methods of a node
+     * do not modify anything, may be called from multiple threads at
+     * once and that Execute() returns its context unchanged. Iterator
+     * loops whose conditions consist only of such nodes are evaluated
+     * in parallel by TvPlan (see TvPlan::BeginLoop()).
+     */
+    #define TVPLUGIN_READONLY           (1 << 2)
+
+    /**
+     * Declares that the results of the PredictContextType(),
+     * AcceptParent() and AcceptChild() methods of a node only depend
+     * on the plugin types of the nodes involved, not on the position
+     * of the node in the tree. Used by TvNode::ValidateContextSafety()
+     * to cache its results.
+     */
+    #define TVPLUGIN_STATICCONTEXT      (1 << 3)
+
+    /**
+     * Declares that Execute() returns its context unchanged and does
+     * not insert, remove or move any element of the document, so that
+     * the elements of an enclosing loop are the same before and after
+     * the node is executed. TVPLUGIN_READONLY implies this. Loops are
+     * only evaluated in parallel if every expression in their body
+     * keeps its context (see TvPlan::BeginLoop()).
+     */
+    #define TVPLUGIN_KEEPSCONTEXT       (1 << 4)
+
     #define TEAPRESSO_HPADDING          2
     #define TEAPRESSO_VPADDING          2
     #define TEAPRESSO_ICONSIZE          16
@@ -84,6 +112,8 @@
     // ===== Cinema Plugin Integration =======================================
     // =======================================================================
 
+    class TvPlan;
+
     /**
      * Public interface for TeaPresso plugin objects.
      */
@@ -100,6 +130,8 @@
 
         Bool AskCondition(TvNode* root, BaseList2D* context);
 
+        Bool Compile(TvPlan* plan);
+
         Bool PredictContextType(Int32 type);
 
         Bool AcceptParent(TvNode* other);
@@ -186,10 +218,26 @@
          *        is actually allowed to be removed, moving it to
          *        another parent doesn't make much sense in most cases,
          *        otherwise.
+         * Each node remembers if its whole subtree passed the
+         * acceptance checks, keyed on the dirty counts and identities
+         * of the node, its children and its parents, and skips the
+         * subtree while the key matches and the result has not been
+         * invalidated (see InvalidateContextSafety()). The node is
+         * only relinked temporarily to *newParent* if it does not
+         * have a static context.
+         *
          * @return The node that did not accept something.
          */
         TvNode* ValidateContextSafety(TvNode* newParent, Bool checkRemoval=true);
 
+        /**
+         * Discards the remembered result of ValidateContextSafety()
+         * of the node and all its parents. Must be called after the
+         * node was inserted, before it is removed and after its
+         * parameters were changed other than through its description.
+         */
+        void InvalidateContextSafety();
+
         /* BaseList2D Overrides */
 
         TvNode* GetDown() {
@@ -221,9 +269,19 @@
 
         typedef NodeData super;
 
+        friend class TvNode;
+
+        // True if the subtree of the node passed the acceptance checks
+        // of TvNode::ValidateContextSafety() with the nodes in the state
+        // described by *validateKey*. Reset by
+        // TvNode::InvalidateContextSafety() for changes further down.
+        UInt64 validateKey;
+        Bool validateAccepted;
+
     public:
 
-        TvOperatorData() : NodeData() {}
+        TvOperatorData() : NodeData(), validateKey(0),
+            validateAccepted(false) {}
 
         virtual ~TvOperatorData() {}
 
@@ -250,6 +308,21 @@
          */
         virtual Bool AskCondition(TvNode* host, TvNode* root, BaseList2D* context);
 
+        /**
+         * Called when the tree is compiled into a TvPlan. The node must
+         * add the instructions that are equivalent to its Execute()
+         * method. The default implementation adds a call to Execute(),
+         * which is correct for every node that does not execute its
+         * child-nodes. Containers and iterators should override this
+         * method so their child-nodes are compiled into the plan as well.
+         *
+         * @param host The node's host object. Cinema 4D owns the
+         *        pointed object.
+         * @param plan The plan to add the instructions to.
+         * @return false if an error occured, true otherwise.
+         */
+        virtual Bool Compile(TvNode* host, TvPlan* plan);
+
         /**
          * @return true when the passed type identifer is a possible
          * context-type forwarded to child-nodes.
@@ -375,6 +448,181 @@
 
     };
 
+    // =======================================================================
+    // ===== Execution Plans =================================================
+    // =======================================================================
+
+    /**
+     * Describes how an iterator node walks over the elements of its
+     * context. Used with TvPlan::BeginLoop().
+     */
+    struct TvIterator {
+        /**
+         * @return The first element to run the loop body with, or
+         *         nullptr if there are no elements in the *context*.
+         */
+        BaseList2D* (*First)(BaseList2D* context);
+
+        /**
+         * @param element The element the loop body was run with.
+         * @param result The context returned by the loop body.
+         * @return The next element or nullptr to end the loop.
+         */
+        BaseList2D* (*Next)(BaseList2D* element, BaseList2D* result);
+    };
+
+    /**
+     * A TeaPresso node tree compiled into a flat list of instructions.
+     * Executing a plan is equivalent to executing the root node of the
+     * tree, but the plugin callbacks of all nodes are resolved once at
+     * compile time and the child-nodes of containers, conditions and
+     * iterators are not dispatched recursively for each element of the
+     * context.
+     *
+     * A plan references the nodes it was compiled from and must be
+     * recompiled when the tree is modified.
+     */
+    class TvPlan {
+
+        enum {
+            OP_EXECUTE,
+            OP_CONDITION,
+            OP_JUMP,
+            OP_LOOP,
+        };
+
+        struct Instruction {
+            Int32 op;
+            TvNode* node;
+            TvOperatorData* data;
+            BaseList2D* (TvOperatorData::*execute)(
+                    TvNode* host, TvNode* root, BaseList2D* context);
+            Bool (TvOperatorData::*askCondition)(
+                    TvNode* host, TvNode* root, BaseList2D* context);
+            const TvIterator* iterator;
+            Bool setRoot;
+            Bool readOnly;
+            Bool keepsContext;
+            Bool parallel;
+            Int32 jump;
+        };
+
+        /**
+         * An expression that was not executed in the parallel pass of
+         * a loop and is applied afterwards.
+         */
+        struct Deferred {
+            Int32 element;
+            Int32 pc;
+        };
+
+        maxon::BaseArray<Instruction> code;
+
+        Bool Append(Int32 op, TvNode* node);
+
+        BaseList2D* Run(Int32 begin, Int32 end, TvNode* root,
+                        BaseList2D* context) const;
+
+        Bool Evaluate(Int32 begin, Int32 end, TvNode* root,
+                      BaseList2D* element, Int32 index,
+                      maxon::BaseArray<Deferred>& deferred) const;
+
+        /**
+         * A range of the elements of a parallel loop that is evaluated
+         * by one thread, see RunParallel().
+         */
+        struct Slice;
+
+        /**
+         * Evaluates a #Slice on its own thread.
+         */
+        class SliceThread;
+
+        static void EvaluateSlice(Slice& slice);
+
+        Bool RunParallel(Int32 loop, TvNode* root, BaseList2D* context) const;
+
+    public:
+
+        /**
+         * Compiles the tree of *node* into the plan, replacing all
+         * instructions that have been compiled before.
+         *
+         * @return false if the tree is not context-safe (see
+         *         TvNode::ValidateContextSafety()) or if an error
+         *         occured.
+         */
+        Bool Compile(TvNode* node);
+
+        /**
+         * Removes all instructions from the plan.
+         */
+        void Flush();
+
+        /**
+         * @return The number of instructions in the plan.
+         */
+        Int32 GetCount() const { return (Int32) code.GetCount(); }
+
+        /**
+         * Runs the plan. Equal to calling TvNode::Execute() on the node
+         * the plan was compiled from.
+         */
+        BaseList2D* Execute(TvNode* root, BaseList2D* context) const {
+            return Run(0, GetCount(), root, context);
+        }
+
+        /**
+         * Adds a call to the Execute() method of *node*.
+         */
+        Bool AddExecute(TvNode* node);
+
+        /**
+         * Compiles all child-nodes of *node* in order.
+         */
+        Bool AddChildren(TvNode* node);
+
+        /**
+         * Begins a loop over the elements produced by *iterator*. The
+         * instructions added until EndLoop() are run for each element
+         * with the element as context. The context is restored after
+         * the loop.
+         *
+         * If all conditions in the loop body are TVPLUGIN_READONLY,
+         * no condition follows an expression that is not and all
+         * expressions keep their context (TVPLUGIN_KEEPSCONTEXT), the
+         * loop runs in two passes when it has many elements: the
+         * conditions are evaluated in parallel for all elements, then
+         * the remaining expressions are applied serially in element
+         * order. The elements are gathered before the first pass,
+         * which gives the same elements as the serial loop because
+         * the body can not change them.
+         *
+         * @param node The iterator node.
+         * @param setRoot Pass true if *node* should be passed as the
+         *        root to the loop body.
+         * @return The index of the loop instruction or NOTOK.
+         */
+        Int32 BeginLoop(TvNode* node, const TvIterator* iterator,
+                        Bool setRoot=false);
+
+        void EndLoop(Int32 loop);
+
+        /**
+         * Begins a branch that is only run if the AskCondition() method
+         * of *node* returns true. Must be closed with EndCondition(),
+         * an optional alternative branch can be started with Else().
+         *
+         * @return The index of the condition instruction or NOTOK.
+         */
+        Int32 BeginCondition(TvNode* node);
+
+        Bool Else(Int32 condition);
+
+        void EndCondition(Int32 condition);
+
+    };
+
     // =======================================================================
     // ===== Plugin Registration =============================================
     // =======================================================================
@@ -410,6 +658,8 @@
                 Bool* refreshTree);
         String (TvOperatorData::*GetDisplayName)(
                 const TvNode* host) const;
+        Bool (TvOperatorData::*Compile)(
+                TvNode* host, TvPlan* plan);
     };
 
     /**
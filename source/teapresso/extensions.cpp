@@ -13,6 +13,63 @@
 
 using c4d_apibridge::GetDescriptionID;
 
+// ===========================================================================
+// ===== Iterators ===========================================================
+// ===========================================================================
+
+static BaseList2D* TvFirstDocument(BaseList2D* context) {
+    return GetFirstDocument();
+}
+
+static BaseList2D* TvNextDocument(BaseList2D* element, BaseList2D* result) {
+    return ((BaseDocument*) element)->GetNext();
+}
+
+static BaseList2D* TvActiveDocument(BaseList2D* context) {
+    return GetActiveDocument();
+}
+
+static BaseList2D* TvNoNext(BaseList2D* element, BaseList2D* result) {
+    return nullptr;
+}
+
+static BaseList2D* TvFirstObject(BaseList2D* context) {
+    if (!context || !context->IsInstanceOf(Tbasedocument)) return nullptr;
+    return ((BaseDocument*) context)->GetFirstObject();
+}
+
+static BaseList2D* TvNextObject(BaseList2D* element, BaseList2D* result) {
+    // Continue with the hierarchy of the object returned by the loop
+    // body. If the body returned nullptr, the remaining objects on the
+    // same level are skipped.
+    BaseObject* op = (BaseObject*) element;
+    BaseObject* next = nullptr;
+    if (result) {
+        op = (BaseObject*) result;
+        next = op->GetDown();
+        if (!next) next = op->GetNext();
+    }
+    while (!next && op) {
+        op = op->GetUp();
+        if (op) next = op->GetNext();
+    }
+    return next;
+}
+
+static BaseList2D* TvFirstTag(BaseList2D* context) {
+    if (!context || !context->IsInstanceOf(Obase)) return nullptr;
+    return ((BaseObject*) context)->GetFirstTag();
+}
+
+static BaseList2D* TvNextTag(BaseList2D* element, BaseList2D* result) {
+    return ((BaseTag*) element)->GetNext();
+}
+
+static const TvIterator TvIterateDocuments = { TvFirstDocument, TvNextDocument };
+static const TvIterator TvIterateActiveDocument = { TvActiveDocument, TvNoNext };
+static const TvIterator TvIterateObjects = { TvFirstObject, TvNextObject };
+static const TvIterator TvIterateTags = { TvFirstTag, TvNextTag };
+
 // ===========================================================================
 // ===== Data Class Definitions ==============================================
 // ===========================================================================
@@ -29,6 +86,8 @@ public:
 
     virtual Bool AskCondition(TvNode* host, TvNode* root, BaseList2D* context);
 
+    virtual Bool Compile(TvNode* host, TvPlan* plan);
+
     virtual Bool PredictContextType(TvNode* host, Int32 type);
 
     virtual Bool AcceptChild(TvNode* host, TvNode* other);
@@ -81,6 +140,12 @@ Bool TvContainerData::AskCondition(TvNode* host, TvNode* root, BaseList2D* conte
     return result;
 }
 
+Bool TvContainerData::Compile(TvNode* host, TvPlan* plan) {
+    if (!host || !plan) return false;
+    if (!host->IsEnabled()) return true;
+    return plan->AddChildren(host);
+}
+
 Bool TvContainerData::PredictContextType(TvNode* host, Int32 type) {
     if (!host) return false;
     TvNode* parent = host->GetUp();
@@ -133,6 +198,8 @@ public:
 
     virtual BaseList2D* Execute(TvNode* host, TvNode* root, BaseList2D* context);
 
+    virtual Bool Compile(TvNode* host, TvPlan* plan);
+
     virtual Bool PredictContextType(TvNode* host, Int32 type);
 
 };
@@ -153,6 +220,14 @@ BaseList2D* TvEachDocumentData::Execute(TvNode* host, TvNode* root, BaseList2D*
     return context;
 }
 
+Bool TvEachDocumentData::Compile(TvNode* host, TvPlan* plan) {
+    if (!host || !plan) return false;
+    Int32 loop = plan->BeginLoop(host, &TvIterateDocuments);
+    if (loop == NOTOK || !plan->AddChildren(host)) return false;
+    plan->EndLoop(loop);
+    return true;
+}
+
 Bool TvEachDocumentData::PredictContextType(TvNode* host, Int32 type) {
     if (!host) return false;
     return type == Tbasedocument;
@@ -171,6 +246,8 @@ public:
 
     virtual BaseList2D* Execute(TvNode* host, TvNode* root, BaseList2D* context);
 
+    virtual Bool Compile(TvNode* host, TvPlan* plan);
+
     virtual Bool AcceptParent(TvNode* host, TvNode* newParent);
 
     virtual Bool PredictContextType(TvNode* host, Int32 type);
@@ -212,6 +289,15 @@ BaseList2D* TvEachObjectData::Execute(TvNode* host, TvNode* root, BaseList2D* co
     return context;
 }
 
+Bool TvEachObjectData::Compile(TvNode* host, TvPlan* plan) {
+    if (!host || !plan) return false;
+    if (!host->IsEnabled() || !host->GetDown()) return true;
+    Int32 loop = plan->BeginLoop(host, &TvIterateObjects);
+    if (loop == NOTOK || !plan->AddChildren(host)) return false;
+    plan->EndLoop(loop);
+    return true;
+}
+
 Bool TvEachObjectData::AcceptParent(TvNode* host, TvNode* newParent) {
     if (!host || !newParent) return false;
     return newParent->PredictContextType(Tbasedocument);
@@ -233,6 +319,8 @@ public:
 
     virtual BaseList2D* Execute(TvNode* host, TvNode* root, BaseList2D* context);
 
+    virtual Bool Compile(TvNode* host, TvPlan* plan);
+
     virtual Bool AcceptParent(TvNode* host, TvNode* newParent);
 
     virtual Bool PredictContextType(TvNode* host, Int32 type);
@@ -247,10 +335,10 @@ BaseList2D* TvEachTagData::Execute(TvNode* host, TvNode* root, BaseList2D* conte
 
     BaseTag* tag = op->GetFirstTag();
     while (tag) {
-        BaseList2D* cContext = context;
+        BaseList2D* cContext = tag;
         TvNode* cNode = host->GetDown();
-        while (cNode) {
-            cContext = cNode->Execute(root, tag);
+        while (cNode && cContext) {
+            cContext = cNode->Execute(root, cContext);
             cNode = cNode->GetNext();
         }
         tag = tag->GetNext();
@@ -259,6 +347,15 @@ BaseList2D* TvEachTagData::Execute(TvNode* host, TvNode* root, BaseList2D* conte
     return context;
 }
 
+Bool TvEachTagData::Compile(TvNode* host, TvPlan* plan) {
+    if (!host || !plan) return false;
+    if (!host->IsEnabled() || !host->GetDown()) return true;
+    Int32 loop = plan->BeginLoop(host, &TvIterateTags);
+    if (loop == NOTOK || !plan->AddChildren(host)) return false;
+    plan->EndLoop(loop);
+    return true;
+}
+
 Bool TvEachTagData::AcceptParent(TvNode* host, TvNode* newParent) {
     if (!host || !newParent) return false;
     return newParent->PredictContextType(Obase);
@@ -281,6 +378,8 @@ public:
 
     virtual BaseList2D* Execute(TvNode* host, TvNode* root, BaseList2D* context);
 
+    virtual Bool Compile(TvNode* host, TvPlan* plan);
+
     virtual Bool PredictContextType(TvNode* host, Int32 type);
 
     virtual Bool AcceptChild(TvNode* host, TvNode* other);
@@ -313,6 +412,25 @@ BaseList2D* TvConditionData::Execute(TvNode* host, TvNode* root, BaseList2D* con
     }
 }
 
+Bool TvConditionData::Compile(TvNode* host, TvPlan* plan) {
+    if (!host || !plan) return false;
+    if (!host->IsEnabled()) return true;
+
+    TvNode* ifNode = host->GetDown();
+    if (!ifNode) return true;
+    TvNode* thenNode = ifNode->GetNext();
+    if (!thenNode) return true;
+    TvNode* elseNode = thenNode->GetNext();
+
+    Int32 condition = plan->BeginCondition(ifNode);
+    if (condition == NOTOK || !thenNode->Compile(plan)) return false;
+    if (elseNode) {
+        if (!plan->Else(condition) || !elseNode->Compile(plan)) return false;
+    }
+    plan->EndCondition(condition);
+    return true;
+}
+
 Bool TvConditionData::PredictContextType(TvNode* host, Int32 type) {
     if (!host) return false;
     TvNode* parent = host->GetUp();
@@ -702,6 +820,8 @@ public:
 
     virtual BaseList2D* Execute(TvNode* host, TvNode* root, BaseList2D* context);
 
+    virtual Bool Compile(TvNode* host, TvPlan* plan);
+
     virtual Bool PredictContextType(TvNode* host, Int32 type);
 
     /* NodeData Overrides */
@@ -712,6 +832,7 @@ public:
 
 BaseList2D* TvCurrentDocumentData::Execute(TvNode* host, TvNode* root, BaseList2D* context) {
     if (!host) return nullptr;
+    if (!host->IsEnabled()) return context;
     BaseDocument* doc = GetActiveDocument();
     if (isRoot) root = host;
     if (doc) {
@@ -720,6 +841,15 @@ BaseList2D* TvCurrentDocumentData::Execute(TvNode* host, TvNode* root, BaseList2
     return context;
 }
 
+Bool TvCurrentDocumentData::Compile(TvNode* host, TvPlan* plan) {
+    if (!host || !plan) return false;
+    if (!host->IsEnabled()) return true;
+    Int32 loop = plan->BeginLoop(host, &TvIterateActiveDocument, isRoot);
+    if (loop == NOTOK || !plan->AddChildren(host)) return false;
+    plan->EndLoop(loop);
+    return true;
+}
+
 Bool TvCurrentDocumentData::PredictContextType(TvNode* host, Int32 type) {
     if (!host) return false;
     return type == Tbasedocument;
@@ -744,7 +874,7 @@ static Bool RegisterTvRoot() {
     return TvRegisterOperatorPlugin(
         Tvroot,
         GeLoadString(IDC_TVROOT),
-        TVPLUGIN_EXPRESSION,
+        TVPLUGIN_EXPRESSION | TVPLUGIN_STATICCONTEXT,
         TvCurrentDocumentData::AllocRoot,
         "Tvroot"_s,
         AutoBitmap("Tvroot.png"_s),
@@ -756,7 +886,7 @@ static Bool RegisterTvCurrentDocument() {
     return TvRegisterOperatorPlugin(
         Tvcurrentdocument,
         GeLoadString(IDC_TVCURRENTDOCUMENT),
-        TVPLUGIN_EXPRESSION,
+        TVPLUGIN_EXPRESSION | TVPLUGIN_STATICCONTEXT,
         TvCurrentDocumentData::Alloc,
         "Tvcurrentdocument"_s,
         AutoBitmap("Tvcurrentdocument.png"_s),
@@ -768,7 +898,7 @@ static Bool RegisterTvContainer() {
     return TvRegisterOperatorPlugin(
         Tvcontainer,
         GeLoadString(IDC_TVCONTAINER),
-        TVPLUGIN_EXPRESSION | TVPLUGIN_CONDITION,
+        TVPLUGIN_EXPRESSION | TVPLUGIN_CONDITION | TVPLUGIN_READONLY,
         TvContainerData::Alloc,
         "Tvcontainer"_s,
         AutoBitmap("Tvcontainer.png"_s),
@@ -779,7 +909,7 @@ static Bool RegisterTvEachDocument() {
     return TvRegisterOperatorPlugin(
         Tveachdocument,
         GeLoadString(IDC_TVEACHDOCUMENT),
-        TVPLUGIN_EXPRESSION,
+        TVPLUGIN_EXPRESSION | TVPLUGIN_STATICCONTEXT,
         TvEachDocumentData::Alloc,
         "Tveachdocument"_s,
         AutoBitmap("Tveachdocument.png"_s),
@@ -791,7 +921,7 @@ static Bool RegisterTvEachObject() {
     return TvRegisterOperatorPlugin(
         Tveachobject,
         GeLoadString(IDC_TVEACHOBJECT),
-        TVPLUGIN_EXPRESSION,
+        TVPLUGIN_EXPRESSION | TVPLUGIN_STATICCONTEXT,
         TvEachObjectData::Alloc,
         "Tveachobject"_s,
         AutoBitmap("Tveachobject.png"_s),
@@ -803,7 +933,7 @@ static Bool RegisterTvEachTag() {
     return TvRegisterOperatorPlugin(
         Tveachtag,
         GeLoadString(IDC_TVEACHTAG),
-        TVPLUGIN_EXPRESSION,
+        TVPLUGIN_EXPRESSION | TVPLUGIN_STATICCONTEXT,
         TvEachTagData::Alloc,
         "Tveachtag"_s,
         AutoBitmap("Tveachtag.png"_s),
@@ -826,7 +956,7 @@ static Bool RegisterIf() {
     return TvRegisterOperatorPlugin(
         Tvif,
         GeLoadString(IDC_TVIF),
-        TVPLUGIN_CONDITION | PLUGINFLAG_HIDEPLUGINMENU,
+        TVPLUGIN_CONDITION | TVPLUGIN_READONLY | PLUGINFLAG_HIDEPLUGINMENU,
         TvIfData::Alloc,
         "Tvif"_s,
         AutoBitmap("Tvif.png"_s),
@@ -859,7 +989,7 @@ static Bool RegisterTvPrintContext() {
     return TvRegisterOperatorPlugin(
         Tvprintcontext,
         GeLoadString(IDC_TVPRINTCONTEXT),
-        TVPLUGIN_EXPRESSION | TVPLUGIN_CONDITION,
+        TVPLUGIN_EXPRESSION | TVPLUGIN_CONDITION | TVPLUGIN_STATICCONTEXT | TVPLUGIN_KEEPSCONTEXT,
         TvPrintContextData::Alloc,
         "Tvprintcontext"_s,
         AutoBitmap("Tvprintcontext.png"_s),
@@ -870,7 +1000,7 @@ static Bool RegisterTvCheckType() {
     return TvRegisterOperatorPlugin(
         Tvchecktype,
         GeLoadString(IDC_TVCHECKTYPE),
-        TVPLUGIN_CONDITION,
+        TVPLUGIN_CONDITION | TVPLUGIN_READONLY | TVPLUGIN_STATICCONTEXT,
         TvCheckTypeData::Alloc,
         "Tvchecktype"_s,
         AutoBitmap("Tvchecktype.png"_s),
@@ -881,7 +1011,7 @@ static Bool RegisterTvIsSelected() {
     return TvRegisterOperatorPlugin(
         Tvisselected,
         GeLoadString(IDC_TVISSELECTED),
-        TVPLUGIN_CONDITION,
+        TVPLUGIN_CONDITION | TVPLUGIN_READONLY | TVPLUGIN_STATICCONTEXT,
         TvIsSelectedData::Alloc,
         "Tvisselected"_s,
         AutoBitmap("Tvisselected.png"_s),
@@ -892,7 +1022,7 @@ static Bool RegisterTvSelect() {
     return TvRegisterOperatorPlugin(
         Tvselect,
         GeLoadString(IDC_TVSELECT),
-        TVPLUGIN_EXPRESSION,
+        TVPLUGIN_EXPRESSION | TVPLUGIN_STATICCONTEXT | TVPLUGIN_KEEPSCONTEXT,
         TvSelectData::Alloc,
         "Tvselect"_s,
         AutoBitmap("Tvselect.png"_s),
@@ -118,12 +118,13 @@ static Bool iTvRegisterOperatorPlugin(
     data.CreateContextMenu  = &TvOperatorData::CreateContextMenu;
     data.ContextMenuCall    = &TvOperatorData::ContextMenuCall;
     data.GetDisplayName     = &TvOperatorData::GetDisplayName;
+    data.Compile            = &TvOperatorData::Compile;
 
     if (destFolder >= 0 && !(info & PLUGINFLAG_HIDEPLUGINMENU)) {
         BaseContainer* folders = iTvGetFolderContainer();
 
         if (destFolder == 0) {
-            switch (info) {
+            switch (info & (TVPLUGIN_EXPRESSION | TVPLUGIN_CONDITION)) {
                 case TVPLUGIN_EXPRESSION:
                     destFolder = TEAPRESSO_FOLDER_EXPRESSIONS;
                     break;
@@ -222,6 +223,7 @@ Bool InitTvLibrary() {
 }
 
 void FreeTvLibrary() {
+    TvFreeAcceptMatrix();
     if (gRootNode) {
         GeListHead* head = gRootNode->GetListHead();
         gRootNode->Remove();
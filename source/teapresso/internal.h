@@ -36,6 +36,12 @@
 
     void FreeTvLibrary();
 
+    /**
+     * Frees the acceptance results cached by
+     * TvNode::ValidateContextSafety(). Called from FreeTvLibrary().
+     */
+    void TvFreeAcceptMatrix();
+
     #define LIBCALL_R(n, r) \
             TvLibrary* lib = TvLibrary::Get(LIBOFFSET(TvLibrary, n)); \
             if (!lib || !lib->n) return r; \
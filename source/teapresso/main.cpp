@@ -37,6 +37,7 @@ Bool SetUpTest() {
     TvNode* condition = TvNode::Alloc(Tvcondition);
     if (condition) {
         condition->InsertUnder(root);
+        condition->InvalidateContextSafety();
         condition->SetUp();
     }
     return true;
@@ -231,6 +232,14 @@ public:
     }
 
     virtual void DeletePressed(void* root, void* ud) override {
+        // The parents of the deleted nodes must validate them again.
+        AutoAlloc<AtomArray> arr;
+        if (root && arr) {
+            TvCollectByBit(BIT_ACTIVE, (TvNode*) root, arr, true);
+            for (Int32 i=0; i < arr->GetCount(); i++) {
+                ((TvNode*) arr->GetIndex(i))->InvalidateContextSafety();
+            }
+        }
         super::DeletePressed(root, ud);
         TvUpdateTreeViews();
     }
@@ -278,6 +287,8 @@ void TvManagerTreeModel::Attach(TreeViewCustomGui* tree) {
 BaseList2D* TvManagerTreeModel::AskInsertObject(
             void* root, void* ud, BaseList2D* node, void** pd, Bool copy) {
     if (!node) return nullptr;
+    // The node is removed from its current parent.
+    ((TvNode*) node)->InvalidateContextSafety();
     if (node->GetBit(BIT_FORCE_UNOPTIMIZED)) {
         *pd = (void*) true;
         copy = true;
@@ -290,6 +301,7 @@ void TvManagerTreeModel::AskInsertObjectDone(
     if (pd) {
         ((TvNode*) node)->SetUp();
     }
+    ((TvNode*) node)->InvalidateContextSafety();
     node->DelBit(BIT_FORCE_UNOPTIMIZED);
 }
 
@@ -318,6 +330,7 @@ Bool TvManagerTreeModel::ContextMenuCall(
                 child->Remove();
                 child = next;
             }
+            ((TvNode*) root)->InvalidateContextSafety();
             TvUpdateTreeViews();
             return true;
         }
@@ -749,8 +762,14 @@ Bool TvManagerDialog::Command(Int32 type, const BaseContainer& msg) {
                 return true;
             }
 
+            TvPlan plan;
+            if (!plan.Compile(root)) {
+                GePrint("Critical: The TeaPresso tree could not be compiled.");
+                return true;
+            }
+
             doc->StartUndo();
-            root->Execute(nullptr, nullptr);
+            plan.Execute(nullptr, nullptr);
             doc->EndUndo();
             EventAdd();
             break;
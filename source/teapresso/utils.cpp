@@ -128,15 +128,18 @@ Bool TvInsertNode(
     switch (insertMode) {
         case INSERT_AFTER:
             newNode->InsertAfter(contextNode);
-            return true;
+            break;
         case INSERT_BEFORE:
             newNode->InsertBefore(contextNode);
-            return true;
+            break;
         case INSERT_UNDER:
             newNode->InsertUnder(contextNode);
-            return true;
+            break;
+        default:
+            return false;
     }
-    return false;
+    newNode->InvalidateContextSafety();
+    return true;
 }
 
 
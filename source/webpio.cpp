@@ -3,12 +3,31 @@
 
 #include <c4d.h>
 #include <c4d_apibridge.h>
+#include "res/c4d_symbols.h"
 #include <webp/decode.h>
 #include <webp/encode.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #define ID_WEBP_BITMAP_SAVER    1030523
 #define ID_WEBP_BITMAP_LOADER   1030524
 #define BASEBITMAP_MAX_DIMENSION 16000
+#define WEBP_READ_CHUNK_SIZE    (64 * 1024)
+#define WEBP_ANIMATION_CACHE_SIZE 4
+
+// Flags of the VP8X chunk and the ANMF frame header, see the WebP
+// container specification.
+#define WEBP_VP8X_ALPHA         0x10
+#define WEBP_ANMF_DISPOSE       0x01
+#define WEBP_ANMF_NO_BLEND      0x02
+
+// Saver settings, stored in the BaseContainer passed to Save() and Edit().
+#define WEBPSAVER_LOSSLESS      1000  // Bool
+#define WEBPSAVER_QUALITY       1001  // Float [0, 100]
+#define WEBPSAVER_METHOD        1002  // Int32 [0, 6]
+#define WEBPSAVER_MULTITHREAD   1003  // Bool
 
 template <typename T, void (*FREE)(void*)> class SmartFree {
 
@@ -29,6 +48,12 @@ public:
         this->ptr = (T*) ptr;
     }
 
+    T* Release() {
+        T* temp = ptr;
+        ptr = nullptr;
+        return temp;
+    }
+
     void Free() {
         if (ptr) {
             FREE(ptr);
@@ -51,8 +76,356 @@ public:
 
 };
 
+/**
+ * Transfers decoded WebP scanlines into a #BaseBitmap. Every row is
+ * written with a single #SetPixelCnt() call for the color channels and,
+ * if present, one for the alpha channel. The alpha plane is read from
+ * the same interleaved RGBA row by using the pixel size as the source
+ * increment, thus no intermediate copy is required.
+ */
+class WebPScanlineWriter {
+
+    BaseBitmap* bm;
+    BaseBitmap* alpha_channel;
+    Int32 width;
+    Int32 pixel_size;
+
+public:
+
+    WebPScanlineWriter(BaseBitmap* bm, BaseBitmap* alpha_channel, Int32 width, Bool has_alpha)
+        : bm(bm), alpha_channel(alpha_channel), width(width), pixel_size(has_alpha ? 4 : 3) {}
+
+    Int32 GetPixelSize() const { return pixel_size; }
+
+    /**
+     * Writes the row *y* from *row* which must contain *width* pixels of
+     * RGB or RGBA data (depending on the *has_alpha* constructor argument).
+     * Fully transparent pixels are cleared to black in place before they
+     * are transferred, matching what Cinema 4D expects for unassociated
+     * alpha.
+     */
+    void WriteRow(Int32 y, uint8_t* row) {
+        if (pixel_size == 4) {
+            uint8_t* pixel = row;
+            for (Int32 x=0; x < width; x++, pixel += 4) {
+                if (pixel[3] < 1) memset(pixel, 0, 3);
+            }
+            if (alpha_channel) {
+                alpha_channel->SetPixelCnt(0, y, width, row + 3, pixel_size, COLORMODE_GRAY, PIXELCNT_0);
+            }
+        }
+        bm->SetPixelCnt(0, y, width, row, pixel_size, COLORMODE_RGB, PIXELCNT_0);
+    }
+
+};
+
+static void FreeIDecoder(void* idec) {
+    WebPIDelete((WebPIDecoder*) idec);
+}
+
+static IMAGERESULT StatusToImageResult(VP8StatusCode status) {
+    switch (status) {
+        case VP8_STATUS_OK:
+            return IMAGERESULT_OK;
+        case VP8_STATUS_OUT_OF_MEMORY:
+            return IMAGERESULT_OUTOFMEMORY;
+        case VP8_STATUS_NOT_ENOUGH_DATA:
+        case VP8_STATUS_BITSTREAM_ERROR:
+        case VP8_STATUS_UNSUPPORTED_FEATURE:
+            return IMAGERESULT_FILESTRUCTURE;
+        default:
+            return IMAGERESULT_MISC_ERROR;
+    }
+}
+
+static uint32_t ReadLE24(const uint8_t* p) {
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16);
+}
+
+static uint32_t ReadLE32(const uint8_t* p) {
+    return ReadLE24(p) | (uint32_t(p[3]) << 24);
+}
+
+/**
+ * Random access to the frames of an animated WebP file. The frames are
+ * indexed once when the file is opened, including the nearest key frame
+ * for every frame. Seeking to a frame only decodes the frames from that
+ * key frame on, or continues from the currently composed frame if it is
+ * closer. Sequential access thus decodes every frame exactly once.
+ */
+class WebPAnimation {
+
+    struct Frame {
+        const uint8_t* data;
+        size_t size;
+        Int32 x, y, width, height;
+        Int32 duration;
+        Bool has_alpha;
+        Bool blend;
+        Bool dispose_background;
+        Int32 keyframe;  // Index of the nearest key frame <= this frame
+    };
+
+    Filename name;
+    Int64 length;
+    LocalFileTime mtime;
+    SmartFree<uint8_t, free> bytes;
+    std::vector<Frame> frames;
+
+    Int32 canvas_width, canvas_height;
+    Bool has_alpha;
+    SmartFree<uint8_t, free> canvas;   // RGBA, the composed *canvas_frame*
+    SmartFree<uint8_t, free> scratch;  // RGBA, the last decoded frame
+    Int32 canvas_frame;
+
+    Bool IsFullFrame(const Frame& frame) const {
+        return frame.width == canvas_width && frame.height == canvas_height;
+    }
+
+    /**
+     * Same rules as libwebp's WebPAnimDecoder to determine whether
+     * a frame can be composed without any of the previous frames.
+     */
+    Bool IsKeyFrame(Int32 index) const {
+        if (index == 0) return true;
+        const Frame& curr = frames[index];
+        const Frame& prev = frames[index - 1];
+        if ((!curr.has_alpha || !curr.blend) && IsFullFrame(curr)) return true;
+        return prev.dispose_background && (IsFullFrame(prev) || prev.keyframe == index - 1);
+    }
+
+    void ClearRect(Int32 x, Int32 y, Int32 width, Int32 height) {
+        for (Int32 j=y; j < y + height; j++) {
+            memset(canvas() + ((Int) j * canvas_width + x) * 4, 0, (Int) width * 4);
+        }
+    }
+
+    /**
+     * Decodes the frame *index* and composes it onto the canvas.
+     */
+    Bool DrawFrame(Int32 index) {
+        const Frame& frame = frames[index];
+        Int stride = (Int) frame.width * 4;
+        Int size = stride * frame.height;
+        if (!WebPDecodeRGBAInto(frame.data, frame.size, scratch, size, (int) stride)) {
+            return false;
+        }
+
+        for (Int32 j=0; j < frame.height; j++) {
+            uint8_t* src = scratch() + j * stride;
+            uint8_t* dst = canvas() + ((Int) (frame.y + j) * canvas_width + frame.x) * 4;
+            if (!frame.blend || !frame.has_alpha) {
+                memcpy(dst, src, stride);
+                continue;
+            }
+            for (Int32 i=0; i < frame.width; i++, src += 4, dst += 4) {
+                uint32_t src_a = src[3];
+                if (src_a == 0) continue;
+                if (src_a == 0xff) {
+                    memcpy(dst, src, 4);
+                    continue;
+                }
+                // Non-premultiplied "source over" as done by libwebp.
+                uint32_t dst_a = (dst[3] * (256 - src_a)) >> 8;
+                uint32_t blend_a = src_a + dst_a;
+                uint32_t scale = (1UL << 24) / blend_a;
+                for (Int32 c=0; c < 3; c++) {
+                    dst[c] = (uint8_t) (((src[c] * src_a + dst[c] * dst_a) * scale) >> 24);
+                }
+                dst[3] = (uint8_t) blend_a;
+            }
+        }
+        return true;
+    }
+
+public:
+
+    WebPAnimation() : length(0), canvas_width(0), canvas_height(0),
+                      has_alpha(false), canvas_frame(-1) {}
+
+    /**
+     * Reads the file and builds the frame index.
+     */
+    IMAGERESULT Open(const Filename& name) {
+        AutoAlloc<BaseFile> file;
+        if (!file->Open(name, FILEOPEN_READ, FILEDIALOG_NONE)) {
+            return IMAGERESULT_NOTEXISTING;
+        }
+        this->name = name;
+        this->length = file->GetLength();
+        GeFGetFileTime(name, GE_FILETIME_MODIFIED, &this->mtime);
+        if (length < 1) {
+            return IMAGERESULT_FILEERROR;
+        }
+
+        bytes = malloc(length);
+        if (!bytes) {
+            return IMAGERESULT_OUTOFMEMORY;
+        }
+        if (file->ReadBytes(bytes, length, true) != length) {
+            return IMAGERESULT_FILESTRUCTURE;
+        }
+
+        // Walk the chunks of the RIFF container. The frame data of an
+        // ANMF chunk (an optional ALPH chunk followed by the VP8/VP8L
+        // chunk) can be passed to the decoder as is.
+        const uint8_t* data = bytes;
+        if (length < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WEBP", 4) != 0) {
+            return IMAGERESULT_FILESTRUCTURE;
+        }
+        Int64 end = 8 + (Int64) ReadLE32(data + 4);
+        if (end > length) end = length;
+
+        Bool has_vp8x = false;
+        Int64 pos = 12;
+        while (pos + 8 <= end) {
+            const uint8_t* chunk = data + pos;
+            Int64 size = ReadLE32(chunk + 4);
+            const uint8_t* payload = chunk + 8;
+            if (size > end - pos - 8) {
+                return IMAGERESULT_FILESTRUCTURE;
+            }
+
+            if (memcmp(chunk, "VP8X", 4) == 0 && size >= 10) {
+                has_vp8x = true;
+                has_alpha = (payload[0] & WEBP_VP8X_ALPHA) != 0;
+                canvas_width = 1 + ReadLE24(payload + 4);
+                canvas_height = 1 + ReadLE24(payload + 7);
+            }
+            else if (memcmp(chunk, "ANMF", 4) == 0) {
+                if (!has_vp8x || size <= 16) {
+                    return IMAGERESULT_FILESTRUCTURE;
+                }
+                Frame frame;
+                frame.x = 2 * ReadLE24(payload);
+                frame.y = 2 * ReadLE24(payload + 3);
+                frame.width = 1 + ReadLE24(payload + 6);
+                frame.height = 1 + ReadLE24(payload + 9);
+                frame.duration = ReadLE24(payload + 12);
+                frame.dispose_background = (payload[15] & WEBP_ANMF_DISPOSE) != 0;
+                frame.blend = (payload[15] & WEBP_ANMF_NO_BLEND) == 0;
+                frame.data = payload + 16;
+                frame.size = (size_t) (size - 16);
+                frame.keyframe = 0;
+
+                WebPBitstreamFeatures features = {0};
+                if (WebPGetFeatures(frame.data, frame.size, &features) != VP8_STATUS_OK ||
+                        features.width != frame.width || features.height != frame.height) {
+                    return IMAGERESULT_FILESTRUCTURE;
+                }
+                frame.has_alpha = features.has_alpha != 0;
+                if (frame.x + frame.width > canvas_width || frame.y + frame.height > canvas_height) {
+                    return IMAGERESULT_FILESTRUCTURE;
+                }
+                frames.push_back(frame);
+                Int32 index = (Int32) frames.size() - 1;
+                frames[index].keyframe = IsKeyFrame(index) ? index : frames[index - 1].keyframe;
+            }
+
+            // Chunks are padded to an even size.
+            pos += 8 + size + (size & 1);
+        }
+        if (canvas_width < 1 || canvas_height < 1) {
+            return IMAGERESULT_FILESTRUCTURE;
+        }
+        if (frames.empty()) {
+            return IMAGERESULT_FILESTRUCTURE;
+        }
+
+        Int size = (Int) canvas_width * canvas_height * 4;
+        canvas = malloc(size);
+        scratch = malloc(size);
+        if (!canvas || !scratch) {
+            return IMAGERESULT_OUTOFMEMORY;
+        }
+        return IMAGERESULT_OK;
+    }
+
+    /**
+     * Returns true if this animation was read from *name* and the file
+     * did not change since.
+     */
+    Bool IsCurrent(const Filename& name) const {
+        if (this->name != name) return false;
+        LocalFileTime mtime;
+        GeFGetFileTime(name, GE_FILETIME_MODIFIED, &mtime);
+        return mtime == this->mtime;
+    }
+
+    Int32 GetFrameCount() const { return (Int32) frames.size(); }
+
+    Float GetFps() const {
+        Int64 total = 0;
+        for (const Frame& frame : frames) total += frame.duration;
+        if (total < 1) return 0.0;
+        return (Float) frames.size() * 1000.0 / (Float) total;
+    }
+
+    /**
+     * Composes the frame *index* and writes it into *bm*.
+     */
+    IMAGERESULT Load(BaseBitmap* bm, Int32 index) {
+        index = ClampValue<Int32>(index, 0, GetFrameCount() - 1);
+
+        if (canvas_frame != index) {
+            Int32 keyframe = frames[index].keyframe;
+            Int32 start;
+            if (canvas_frame >= keyframe && canvas_frame < index) {
+                start = canvas_frame + 1;
+            }
+            else {
+                ClearRect(0, 0, canvas_width, canvas_height);
+                start = keyframe;
+            }
+
+            for (Int32 i=start; i <= index; i++) {
+                if (i > start || start != keyframe) {
+                    const Frame& prev = frames[i - 1];
+                    if (prev.dispose_background) {
+                        ClearRect(prev.x, prev.y, prev.width, prev.height);
+                    }
+                }
+                if (!DrawFrame(i)) {
+                    canvas_frame = -1;
+                    return IMAGERESULT_FILESTRUCTURE;
+                }
+                canvas_frame = i;
+            }
+        }
+
+        IMAGERESULT result = bm->Init(canvas_width, canvas_height, has_alpha ? 32 : 24);
+        if (result != IMAGERESULT_OK) {
+            return result;
+        }
+        BaseBitmap* alpha_channel = nullptr;
+        if (has_alpha) {
+            alpha_channel = bm->AddChannel(true, true);
+        }
+
+        // The writer clears the color of transparent pixels in place,
+        // which does not affect the composition of later frames.
+        WebPScanlineWriter writer(bm, alpha_channel, canvas_width, true);
+        for (Int32 y=0; y < canvas_height; y++) {
+            writer.WriteRow(y, canvas() + (Int) y * canvas_width * 4);
+        }
+        return IMAGERESULT_OK;
+    }
+
+};
+
 class WebPBitmapImporter : public BitmapLoaderData {
 
+    std::mutex animations_lock;
+    std::vector<std::unique_ptr<WebPAnimation>> animations;  // Most recently used first
+
+    /**
+     * Returns the indexed animation for *name*, opening it if it is not
+     * in the cache yet. Must be called with the *animations_lock* held.
+     */
+    WebPAnimation* GetAnimation(const Filename& name, IMAGERESULT& result);
+
+    IMAGERESULT LoadAnimation(const Filename& name, BaseBitmap* bm, Int32 frame);
+
 public:
 
     ///// BitmapLoaderData
@@ -61,6 +434,8 @@ public:
 
     IMAGERESULT Load(const Filename& name, BaseBitmap* bm, Int32 frame);
 
+    Bool GetInformation(const Filename& name, Int32& frames, Float& fps);
+
     Int32 GetSaver() { return ID_WEBP_BITMAP_SAVER; }
 
 };
@@ -73,7 +448,7 @@ public:
 
     IMAGERESULT Save(const Filename& name, BaseBitmap* bm, BaseContainer* data, SAVEBIT savebits);
 
-    /* Bool Edit(BaseContainer* data); */
+    Bool Edit(BaseContainer* data);
 
     Int32 GetMaxAlphas(BaseContainer* data) { return 1; }
 
@@ -101,69 +476,228 @@ IMAGERESULT WebPBitmapImporter::Load(const Filename& name, BaseBitmap* bm, Int32
         return IMAGERESULT_FILEERROR;
     }
 
-    SmartFree<uint8_t, free> bytes(malloc(length));
-    if (!bytes) {
+    // Read from the file until we have enough data to retrieve the
+    // image features. Usually, the first chunk is sufficient, but the
+    // extended format may contain arbitrarily large metadata before
+    // the actual image data.
+    Int capacity = WEBP_READ_CHUNK_SIZE;
+    SmartFree<uint8_t, free> buffer(malloc(capacity));
+    if (!buffer) {
         return IMAGERESULT_OUTOFMEMORY;
     }
 
-    Int bytes_read = file->ReadBytes(bytes, length, true);
-
-    // Retrieve the image features.
+    Int bytes_read = file->ReadBytes(buffer, capacity, true);
     WebPBitstreamFeatures features = {0};
-    VP8StatusCode status = WebPGetFeatures(bytes, bytes_read, &features);
-    switch (status) {
-        case VP8_STATUS_OK:
-            break;
-        case VP8_STATUS_OUT_OF_MEMORY:
+    VP8StatusCode status = WebPGetFeatures(buffer, bytes_read, &features);
+    while (status == VP8_STATUS_NOT_ENOUGH_DATA && bytes_read == capacity) {
+        void* grown = realloc(buffer, capacity * 2);
+        if (!grown) {
             return IMAGERESULT_OUTOFMEMORY;
-        case VP8_STATUS_NOT_ENOUGH_DATA:
-        case VP8_STATUS_BITSTREAM_ERROR:
-            return IMAGERESULT_FILESTRUCTURE;
-        default:
-            return IMAGERESULT_MISC_ERROR;
+        }
+        buffer.Release();
+        buffer = grown;
+        bytes_read += file->ReadBytes(buffer() + capacity, capacity, true);
+        capacity *= 2;
+        status = WebPGetFeatures(buffer, bytes_read, &features);
     }
-
-    // Decode the image.
-    SmartFree<uint8_t, free> image_data;
-    Int32 width, height;
-    if (features.has_alpha) {
-        image_data = WebPDecodeRGBA(bytes, bytes_read, &width, &height);
+    if (status != VP8_STATUS_OK) {
+        return StatusToImageResult(status);
     }
-    else {
-        image_data = WebPDecodeRGB(bytes, bytes_read, &width, &height);
+    if (features.has_animation) {
+        file->Close();
+        return LoadAnimation(name, bm, frame);
     }
 
-    if (!image_data) {
-        return IMAGERESULT_OUTOFMEMORY;
-    }
+    Int32 width = features.width;
+    Int32 height = features.height;
     if (width < 1 || height < 1) {
         return IMAGERESULT_FILESTRUCTURE;
     }
 
-    // Write the image data into the bitmap.
+    // Prepare the bitmap so that decoded rows can be written directly.
     Int32 depth = features.has_alpha ? 32 : 24;
     IMAGERESULT result = bm->Init(width, height, depth);
     if (result != IMAGERESULT_OK) {
         return result;
     }
 
-    Int32 pixel_count = features.has_alpha ? 4 : 3;
     BaseBitmap* alpha_channel = nullptr;
     if (features.has_alpha) {
         alpha_channel = bm->AddChannel(true, true);
     }
 
-    for (Int32 x=0; x < width; x++) {
-        for (Int32 y=0; y < height; y++) {
-            Int32 index = (y * width + x) * pixel_count;
-            uint8_t* pixel = image_data() + index;
+    WEBP_CSP_MODE mode = features.has_alpha ? MODE_RGBA : MODE_RGB;
+    SmartFree<WebPIDecoder, FreeIDecoder> idec(WebPINewRGB(mode, nullptr, 0, 0));
+    if (!idec) {
+        return IMAGERESULT_OUTOFMEMORY;
+    }
 
-            if (alpha_channel) {
-                alpha_channel->SetPixelCnt(x, y, 1, pixel + 3, alpha_channel->GetBt()/8, COLORMODE_GRAY, PIXELCNT_0);
-                if (pixel[3] < 1) memset(pixel, 0, 3);
+    // Feed the decoder chunk by chunk and pass every scanline to the
+    // bitmap as soon as it is finished.
+    WebPScanlineWriter writer(bm, alpha_channel, width, features.has_alpha != 0);
+    Int32 rows_written = 0;
+    status = WebPIAppend(idec, buffer, bytes_read);
+    while (true) {
+        if (status != VP8_STATUS_OK && status != VP8_STATUS_SUSPENDED) {
+            return StatusToImageResult(status);
+        }
+
+        int last_y = 0, stride = 0;
+        uint8_t* rgb = WebPIDecGetRGB(idec, &last_y, nullptr, nullptr, &stride);
+        if (rgb) {
+            for (; rows_written < last_y && rows_written < height; rows_written++) {
+                writer.WriteRow(rows_written, rgb + (Int) rows_written * stride);
             }
+        }
 
-            bm->SetPixel(x, y, pixel[0], pixel[1], pixel[2]);
+        if (status == VP8_STATUS_OK) break;
+
+        bytes_read = file->ReadBytes(buffer, capacity, true);
+        if (bytes_read < 1) {
+            // The file ended before the image was complete.
+            return IMAGERESULT_FILESTRUCTURE;
+        }
+        status = WebPIAppend(idec, buffer, bytes_read);
+    }
+
+    return IMAGERESULT_OK;
+}
+
+WebPAnimation* WebPBitmapImporter::GetAnimation(const Filename& name, IMAGERESULT& result) {
+    result = IMAGERESULT_OK;
+    for (auto it = animations.begin(); it != animations.end(); ++it) {
+        if ((*it)->IsCurrent(name)) {
+            std::rotate(animations.begin(), it, it + 1);
+            return animations.front().get();
+        }
+    }
+
+    std::unique_ptr<WebPAnimation> animation(new WebPAnimation);
+    result = animation->Open(name);
+    if (result != IMAGERESULT_OK) {
+        return nullptr;
+    }
+    if (animations.size() >= WEBP_ANIMATION_CACHE_SIZE) {
+        animations.pop_back();
+    }
+    animations.insert(animations.begin(), std::move(animation));
+    return animations.front().get();
+}
+
+IMAGERESULT WebPBitmapImporter::LoadAnimation(const Filename& name, BaseBitmap* bm, Int32 frame) {
+    std::lock_guard<std::mutex> lock(animations_lock);
+    IMAGERESULT result;
+    WebPAnimation* animation = GetAnimation(name, result);
+    if (!animation) {
+        return result;
+    }
+    return animation->Load(bm, frame);
+}
+
+Bool WebPBitmapImporter::GetInformation(const Filename& name, Int32& frames, Float& fps) {
+    UChar probe[64];
+    AutoAlloc<BaseFile> file;
+    if (!file->Open(name, FILEOPEN_READ, FILEDIALOG_NONE)) {
+        return false;
+    }
+    Int size = file->ReadBytes(probe, sizeof(probe), true);
+    file->Close();
+
+    WebPBitstreamFeatures features = {0};
+    if (WebPGetFeatures(probe, size, &features) != VP8_STATUS_OK || !features.has_animation) {
+        frames = 1;
+        fps = 0.0;
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(animations_lock);
+    IMAGERESULT result;
+    WebPAnimation* animation = GetAnimation(name, result);
+    if (!animation) {
+        return false;
+    }
+    frames = animation->GetFrameCount();
+    fps = animation->GetFps();
+    return true;
+}
+
+/**
+ * #WebPWriterFunction that passes the encoded data directly to the
+ * #BaseFile that is stored in the pictures *custom_ptr*.
+ */
+static int WriteToBaseFile(const uint8_t* data, size_t data_size, const WebPPicture* picture) {
+    BaseFile* file = static_cast<BaseFile*>(picture->custom_ptr);
+    return file->WriteBytes(data, data_size) ? 1 : 0;
+}
+
+/**
+ * Frees the #WebPPicture when it goes out of scope.
+ */
+class AutoWebPPicture {
+
+    WebPPicture* picture;
+
+public:
+
+    AutoWebPPicture(WebPPicture* picture) : picture(picture) {}
+
+    ~AutoWebPPicture() { WebPPictureFree(picture); }
+
+};
+
+/**
+ * Fills the encoder *config* from the saver settings in *data*. The
+ * defaults match the lossless-only behaviour of earlier versions.
+ */
+static Bool InitConfig(const BaseContainer* data, WebPConfig* config) {
+    BaseContainer empty;
+    if (!data) data = &empty;
+
+    if (!WebPConfigInit(config)) {
+        return false;
+    }
+    config->lossless = data->GetBool(WEBPSAVER_LOSSLESS, true) ? 1 : 0;
+    config->quality = (float) ClampValue<Float>(data->GetFloat(WEBPSAVER_QUALITY, 75.0), 0.0, 100.0);
+    config->method = ClampValue<Int32>(data->GetInt32(WEBPSAVER_METHOD, 4), 0, 6);
+    config->thread_level = data->GetBool(WEBPSAVER_MULTITHREAD, true) ? 1 : 0;
+    return WebPValidateConfig(config) != 0;
+}
+
+/**
+ * Allocates the ARGB plane of *picture* and fills it from *bm*, reading
+ * the bitmap row by row. The caller must free the picture with
+ * #WebPPictureFree(), even if the function fails.
+ */
+static IMAGERESULT InitPicture(BaseBitmap* bm, BaseBitmap* alpha_channel, WebPPicture* picture) {
+    Int32 width = bm->GetBw();
+    Int32 height = bm->GetBh();
+
+    if (!WebPPictureInit(picture)) {
+        return IMAGERESULT_MISC_ERROR;
+    }
+    picture->use_argb = 1;
+    picture->width = width;
+    picture->height = height;
+    if (!WebPPictureAlloc(picture)) {
+        return IMAGERESULT_OUTOFMEMORY;
+    }
+
+    SmartFree<uint8_t, free> row(malloc(width * 4));
+    if (!row) {
+        return IMAGERESULT_OUTOFMEMORY;
+    }
+
+    for (Int32 y=0; y < height; y++) {
+        bm->GetPixelCnt(0, y, width, row, 4, COLORMODE_RGB, PIXELCNT_0);
+        if (alpha_channel) {
+            alpha_channel->GetPixelCnt(0, y, width, row() + 3, 4, COLORMODE_GRAY, PIXELCNT_0);
+        }
+
+        uint32_t* dest = picture->argb + (Int) y * picture->argb_stride;
+        const uint8_t* pixel = row;
+        for (Int32 x=0; x < width; x++, pixel += 4) {
+            uint32_t a = alpha_channel ? pixel[3] : 0xff;
+            dest[x] = (a << 24) | (uint32_t(pixel[0]) << 16) | (uint32_t(pixel[1]) << 8) | pixel[2];
         }
     }
 
@@ -183,70 +717,103 @@ IMAGERESULT WebPBitmapExporter::Save(const Filename& name, BaseBitmap* bm, BaseC
         return IMAGERESULT_OUTOFMEMORY;
     }
 
-    Int32 pixel_count = savebits & SAVEBIT_ALPHA ? 4 : 3;
-    Int32 image_size = width * height * pixel_count;
-    SmartFree<uint8_t, free> image_data(calloc(image_size, 1));
-    if (!image_data) {
-        return IMAGERESULT_OUTOFMEMORY;
+    WebPConfig config;
+    if (!InitConfig(data, &config)) {
+        return IMAGERESULT_MISC_ERROR;
     }
 
     BaseBitmap* alpha_channel = bm->GetInternalChannel();
     if (!Bool(savebits & SAVEBIT_ALPHA)) alpha_channel = nullptr;
 
-    for (Int32 x=0; x < width; x++) {
-        for (Int32 y=0; y < height; y++) {
+    WebPPicture picture = {0};
+    AutoWebPPicture picture_free(&picture);
+    IMAGERESULT result = InitPicture(bm, alpha_channel, &picture);
+    if (result != IMAGERESULT_OK) {
+        return result;
+    }
+
+    AutoAlloc<BaseFile> file;
+    if (!file->Open(name, FILEOPEN_WRITE, FILEDIALOG_NONE)) {
+        return IMAGERESULT_MISC_ERROR;
+    }
 
-            Int32 index = (y * width + x) * pixel_count;
-            uint8_t* pixel = image_data() + index;
+    picture.writer = WriteToBaseFile;
+    picture.custom_ptr = file;
+    if (!WebPEncode(&config, &picture)) {
+        GeDebugOut(">> WebPEncode() failed.");
+        if (picture.error_code == VP8_ENC_ERROR_OUT_OF_MEMORY ||
+                picture.error_code == VP8_ENC_ERROR_BITSTREAM_OUT_OF_MEMORY) {
+            return IMAGERESULT_OUTOFMEMORY;
+        }
+        return IMAGERESULT_MISC_ERROR;
+    }
 
-            UInt16 r, g, b;
-            bm->GetPixel(x, y, &r, &g, &b);
+    return IMAGERESULT_OK;
+}
 
-            pixel[0] = r;
-            pixel[1] = g;
-            pixel[2] = b;
+/**
+ * Modal dialog to edit the WebP saver settings.
+ */
+class WebPSaverDialog : public GeDialog {
 
-            if (alpha_channel) {
-                UInt16 a;
-                bm->GetAlphaPixel(alpha_channel, x, y, &a);
-                pixel[3] = a;
-            }
+    typedef GeDialog super;
 
-        }
-    }
+    BaseContainer* data;
 
-    Int32 stride = width * pixel_count;
+public:
 
-    size_t size;
-    uint8_t* output_image = nullptr;
-    if (savebits & SAVEBIT_ALPHA) {
-        size = WebPEncodeLosslessRGBA(image_data, width, height, stride, &output_image);
-    }
-    else {
-        size = WebPEncodeLosslessRGB(image_data, width, height, stride, &output_image);
-    }
+    Bool accepted;
 
+    WebPSaverDialog(BaseContainer* data) : data(data), accepted(false) {}
 
-    SmartFree<uint8_t, free> output_image_smart(output_image);
+    ///// GeDialog
 
-    if (size < 1 || !output_image) {
-        GeDebugOut(">> Writer has not size or not mem.");
-        return IMAGERESULT_MISC_ERROR;
+    Bool CreateLayout() {
+        return LoadDialogResource(IDS_WEBP_DLG_OPTIONS, nullptr, 0);
     }
 
-    AutoAlloc<BaseFile> file;
-    if (!file->Open(name, FILEOPEN_WRITE, FILEDIALOG_NONE)) {
-        return IMAGERESULT_MISC_ERROR;
+    Bool InitValues() {
+        SetBool(IDS_WEBP_CHK_LOSSLESS, data->GetBool(WEBPSAVER_LOSSLESS, true));
+        SetFloat(IDS_WEBP_EDT_QUALITY, data->GetFloat(WEBPSAVER_QUALITY, 75.0), 0.0, 100.0, 1.0);
+        SetInt32(IDS_WEBP_EDT_METHOD, data->GetInt32(WEBPSAVER_METHOD, 4), 0, 6, 1);
+        SetBool(IDS_WEBP_CHK_MULTITHREAD, data->GetBool(WEBPSAVER_MULTITHREAD, true));
+        return super::InitValues();
     }
 
-    IMAGERESULT result = IMAGERESULT_MISC_ERROR;
-    do {
-        if (!file->WriteBytes(output_image, size)) break;
-        result = IMAGERESULT_OK;
+    Bool Command(Int32 id, const BaseContainer& msg) {
+        switch (id) {
+            case IDC_OK: {
+                Bool lossless = true, multithread = true;
+                Float quality = 75.0;
+                Int32 method = 4;
+                GetBool(IDS_WEBP_CHK_LOSSLESS, lossless);
+                GetFloat(IDS_WEBP_EDT_QUALITY, quality);
+                GetInt32(IDS_WEBP_EDT_METHOD, method);
+                GetBool(IDS_WEBP_CHK_MULTITHREAD, multithread);
+                data->SetBool(WEBPSAVER_LOSSLESS, lossless);
+                data->SetFloat(WEBPSAVER_QUALITY, quality);
+                data->SetInt32(WEBPSAVER_METHOD, method);
+                data->SetBool(WEBPSAVER_MULTITHREAD, multithread);
+                accepted = true;
+                Close();
+                break;
+            }
+            case IDC_CANCEL:
+                Close();
+                break;
+            default:
+                break;
+        }
+        return super::Command(id, msg);
     }
-    while (0);
 
-    return result;
+};
+
+Bool WebPBitmapExporter::Edit(BaseContainer* data) {
+    if (!data) return false;
+    WebPSaverDialog dialog(data);
+    dialog.Open(DLG_TYPE_MODAL, 0);
+    return dialog.accepted;
 }
 
 
@@ -254,13 +821,14 @@ Bool RegisterWebpIO() {
     RegisterBitmapLoaderPlugin(
         /* id   */ ID_WEBP_BITMAP_LOADER,
         /* name */ "WebP"_s,
-        /* info */ 0,
+        /* info */ PLUGINFLAG_BITMAPLOADER_MOVIE,
         /* data */ NewObjClear(WebPBitmapImporter));
 
     RegisterBitmapSaverPlugin(
         /* id     */ ID_WEBP_BITMAP_SAVER,
         /* name   */ "WebP"_s,
-        /* info   */ PLUGINFLAG_BITMAPSAVER_SUPPORT_8BIT | PLUGINFLAG_BITMAPSAVER_FORCESUFFIX,
+        /* info   */ PLUGINFLAG_BITMAPSAVER_SUPPORT_8BIT | PLUGINFLAG_BITMAPSAVER_FORCESUFFIX |
+                      PLUGINFLAG_BITMAPSAVER_ALLOWOPTIONS,
         /* data   */ NewObjClear(WebPBitmapExporter),
         /* suffix */ "webp"_s);
 
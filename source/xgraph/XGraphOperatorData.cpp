@@ -17,43 +17,97 @@
 
 using niklasrosenstein::c4d::auto_bitmap;
 
+/**
+ * The minimum and maximum of a range of records.
+ */
+struct XGraphExtent {
+
+    Float lo, hi;
+
+    static XGraphExtent Empty() {
+        XGraphExtent e;
+        e.lo = 1;
+        e.hi = 0;
+        return e;
+    }
+
+    Bool IsEmpty() const {
+        return lo > hi;
+    }
+
+    void Add(const XGraphExtent& other) {
+        if (other.IsEmpty()) return;
+        if (IsEmpty()) {
+            *this = other;
+            return;
+        }
+        if (other.lo < lo) lo = other.lo;
+        if (other.hi > hi) hi = other.hi;
+    }
+
+};
+
 class XRealGraph : public XGraphData {
 
+    /**
+     * One record per frame of the document's time range. The buffer is
+     * only reallocated when the time range changes. Playback moves the
+     * write head (*last_record_index*) around it like in a ring buffer,
+     * records after the head are from the previous pass and outdated.
+     */
     std::vector<Float> records;
     Int32 record_count;
-    Int32 filled_records;
     Int32 last_record_index;
 
-    Float y_min;
-    Float y_max;
+    /**
+     * Min/max pyramid over the records. Level 0 contains the extent of
+     * each record (empty if it has not been recorded yet), every next
+     * level half as many extents, the last level the extent of all
+     * records. Updated incrementally in StoreRecord().
+     */
+    std::vector<std::vector<XGraphExtent>> pyramid;
+
+    void RebuildPyramid();
+
+    XGraphExtent Query(Int32 first, Int32 last) const;
 
 public:
 
     Int32 port_id;
 
-    XRealGraph(Int32 port_id=0) : port_id(port_id), records(NULL), record_count(0),
-            filled_records(0), last_record_index(-1), y_min(0), y_max(0) {
+    XRealGraph(Int32 port_id=0) : record_count(0), last_record_index(-1),
+            port_id(port_id) {
     }
 
     virtual ~XRealGraph() {
     }
 
     void SetCount(Int32 count) {
+        if (count < 0) count = 0;
+        if (count == record_count) return;
         records.resize(count);
         record_count = count;
-        if (filled_records > count) {
-            filled_records = count;
+        if (last_record_index >= count) {
+            last_record_index = count - 1;
         }
+        RebuildPyramid();
     }
 
     void StoreRecord(Int32 frame, Float value) {
         if (frame < 0 || frame >= record_count) return;
         records[frame] = value;
         last_record_index = frame;
-        if (frame > filled_records) filled_records = frame;
 
-        if (value < y_min) y_min = value;
-        if (value > y_max) y_max = value;
+        // Update the extents from the record up to the top.
+        size_t index = frame;
+        pyramid[0][index].lo = pyramid[0][index].hi = value;
+        for (size_t level=1; level < pyramid.size(); level++) {
+            index /= 2;
+            const std::vector<XGraphExtent>& below = pyramid[level - 1];
+            XGraphExtent e = below[index * 2];
+            if (index * 2 + 1 < below.size()) e.Add(below[index * 2 + 1]);
+            pyramid[level][index] = e;
+        }
     }
 
     //////// XGraphData
@@ -62,24 +116,54 @@ public:
 
     Float GetValue(Float x, XGraphValueState* state) const;
 
+    Bool GetValueRange(Float x1, Float x2, Float* y_min, Float* y_max,
+                       XGraphValueState* state) const;
+
 };
 
+void XRealGraph::RebuildPyramid() {
+    std::vector<XGraphExtent> leaves;
+    if (!pyramid.empty()) leaves = std::move(pyramid[0]);
+    leaves.resize(record_count, XGraphExtent::Empty());
+
+    pyramid.clear();
+    pyramid.push_back(std::move(leaves));
+    while (pyramid.back().size() > 1) {
+        const std::vector<XGraphExtent>& below = pyramid.back();
+        std::vector<XGraphExtent> level((below.size() + 1) / 2);
+        for (size_t i=0; i < level.size(); i++) {
+            level[i] = below[i * 2];
+            if (i * 2 + 1 < below.size()) level[i].Add(below[i * 2 + 1]);
+        }
+        pyramid.push_back(std::move(level));
+    }
+}
+
+XGraphExtent XRealGraph::Query(Int32 first, Int32 last) const {
+    XGraphExtent result = XGraphExtent::Empty();
+    size_t l = first, r = last + 1;
+    for (size_t level=0; level < pyramid.size() && l < r; level++) {
+        const std::vector<XGraphExtent>& extents = pyramid[level];
+        if (l & 1) result.Add(extents[l++]);
+        if (r & 1) result.Add(extents[--r]);
+        l /= 2;
+        r /= 2;
+    }
+    return result;
+}
+
 void XRealGraph::GetRange(Float* x_min, Float* x_max, Float* y_min, Float* y_max) const {
     *x_min = 0;
     *x_max = record_count;
+    *y_min = *y_max = 0;
 
     if (record_count > 0) {
-        *y_min = *y_max = records[0];
-        for (Int32 i=1; i < filled_records; i++) {
-            Float x = records[i];
-            if (x < *y_min) *y_min = x;
-            if (x > *y_max) *y_max = x;
+        const XGraphExtent& all = pyramid.back()[0];
+        if (!all.IsEmpty()) {
+            *y_min = all.lo;
+            *y_max = all.hi;
         }
     }
-    else {
-        *y_min = this->y_min;
-        *y_max = this->y_max;
-    }
 }
 
 Float XRealGraph::GetValue(Float x, XGraphValueState* state) const {
@@ -105,6 +189,26 @@ Float XRealGraph::GetValue(Float x, XGraphValueState* state) const {
     return -1;
 }
 
+Bool XRealGraph::GetValueRange(Float x1, Float x2, Float* y_min, Float* y_max,
+            XGraphValueState* state) const {
+    Int32 first = Int32(Floor(x1)) + 1;
+    Int32 last = Int32(Floor(x2));
+    if (first < 0) first = 0;
+    if (last > record_count - 1) last = record_count - 1;
+    if (last - first < 1) return FALSE;
+
+    XGraphExtent e = Query(first, last);
+    if (e.IsEmpty()) return FALSE;
+
+    *y_min = e.lo;
+    *y_max = e.hi;
+    *state |= XGraphValueState_Valid;
+    if (first > last_record_index) {
+        *state |= XGraphValueState_Outdated;
+    }
+    return TRUE;
+}
+
 
 class XGraphOperatorData : public GvOperatorData {
 
@@ -112,8 +216,25 @@ class XGraphOperatorData : public GvOperatorData {
 
     XGraphView view;
     XGraphDisplay display;
+
+    /**
+     * One graph per in-port, in the same order as the in-values in
+     * *values*. Assigned by port ID in InitCalculation().
+     */
     std::vector<XRealGraph> graphs;
 
+    /**
+     * The in-values of the node, valid between InitCalculation() and
+     * FreeCalculation(). Owned by this node, so any number of XGraph
+     * nodes can be calculated in the same XPresso graph.
+     */
+    GvValuesInfo values;
+
+    /**
+     * Returns the smallest port ID that is not used by an in-port.
+     */
+    static Int32 NextPortId(GvNode* host);
+
 public:
 
     static NodeData* Alloc() { return NewObjClear(XGraphOperatorData); }
@@ -133,6 +254,10 @@ public:
 
     virtual void GetBodySize(GvNode* host, Int32* width, Int32* height);
 
+    virtual Bool InitCalculation(GvNode* host, GvCalc* calc, GvRun* run);
+
+    virtual void FreeCalculation(GvNode* host, GvCalc* calc);
+
     virtual Bool Calculate(GvNode* host, GvPort* port, GvRun* run, GvCalc* calc);
 
     virtual Bool AddToCalculationTable(GvNode* host, GvRun* run);
@@ -165,31 +290,7 @@ Int32 XGraphOperatorData::FillPortsMenu(GvNode* host, BaseContainer& names,
     Int32 id = first_menu_id;
 
     if (port == GV_PORT_INPUT) {
-        Int32 count = host->GetInPortCount();
-        Int32 port_id = ID_XGRAPH_PORT_START;
-
-        // Check for the next free id.
-        while (TRUE) {
-            Bool found = FALSE;
-
-            // Check if the port ID already exists.
-            for (Int32 i=0; i < count; i++) {
-                GvPort* port = host->GetInPort(i);
-                Int32 id = port->GetMainID();
-                if (id == port_id) {
-                    found = TRUE;
-                    break;
-                }
-            }
-
-            if (found) {
-                port_id++;
-            }
-            else {
-                break;
-            }
-        }
-
+        Int32 port_id = NextPortId(host);
         names.SetString(id, GeLoadString(IDS_GVPORT_NAME_REAL));
         ids.SetInt32(id, port_id);
         id++;
@@ -210,6 +311,63 @@ void XGraphOperatorData::GetBodySize(GvNode* host, Int32* width, Int32* height)
     *height = 80;
 }
 
+Int32 XGraphOperatorData::NextPortId(GvNode* host) {
+    // Collect the used IDs in one pass. With *count* ports, at least one
+    // ID in the range checked below is unused.
+    Int32 count = host->GetInPortCount();
+    c4d_apibridge::HashMap<Int32, Bool> used;
+    for (Int32 i=0; i < count; i++) {
+        GvPort* port = host->GetInPort(i);
+        if (!port) continue;
+        maxon::Bool created = false;
+        (void) used.FindOrCreateEntry(port->GetMainID(), created);
+    }
+    Int32 id = ID_XGRAPH_PORT_START;
+    while (id < ID_XGRAPH_PORT_START + count && used.FindEntry(id)) {
+        id++;
+    }
+    return id;
+}
+
+Bool XGraphOperatorData::InitCalculation(GvNode* host, GvCalc* calc, GvRun* run) {
+    if (!GvBuildValuesTable(host, values, calc, run, GV_EXISTING_PORTS)) {
+        return FALSE;
+    }
+
+    #if API_VERSION < 20000
+    Int count = values.nr_of_in_values;
+    #else
+    Int count = values.in_values.GetCount();
+    #endif
+
+    // Match the graphs with the in-values by port ID, so that the records
+    // stay with their port when other ports are added or removed.
+    c4d_apibridge::HashMap<Int32, Int32> by_id;
+    for (Int32 i=0; i < (Int32) graphs.size(); i++) {
+        maxon::Bool created = false;
+        auto entry = by_id.FindOrCreateEntry(graphs[i].port_id, created);
+        if (entry) entry->GetValue() = i;
+    }
+
+    std::vector<XRealGraph> new_graphs(count);
+    for (Int32 i=0; i < count; i++) {
+        GvValue* value = values.GetInValue(i);
+        if (!value) continue;
+        Int32 port_id = value->GetMainID();
+        auto entry = by_id.FindEntry(port_id);
+        if (entry) new_graphs[i] = std::move(graphs[entry->GetValue()]);
+        new_graphs[i].port_id = port_id;
+    }
+    graphs = std::move(new_graphs);
+
+    return super::InitCalculation(host, calc, run);
+}
+
+void XGraphOperatorData::FreeCalculation(GvNode* host, GvCalc* calc) {
+    GvFreeValuesTable(host, values);
+    super::FreeCalculation(host, calc);
+}
+
 Bool XGraphOperatorData::Calculate(GvNode* host, GvPort* port, GvRun* run, GvCalc* calc) {
     BaseDocument* doc = calc->document;
     BaseTime t = doc->GetTime();
@@ -218,33 +376,32 @@ Bool XGraphOperatorData::Calculate(GvNode* host, GvPort* port, GvRun* run, GvCal
     Int32 maxtime = doc->GetMaxTime().GetFrame(fps);
     Int32 frame = t.GetFrame(fps);
 
-    Int32 count = host->GetInPortCount();
-    graphs.resize(count);
+    // All in-ports are calculated together in the current run. The run
+    // ID is not incremented afterwards: that was only needed to get
+    // fresh values from the per-port calculation handlers, and doing it
+    // here would make the other nodes calculate again in this pass.
+    if (!GvCalculateInValuesTable(host, run, calc, values)) {
+        GeDebugOut("GvCalculateInValuesTable() failed.");
+        return FALSE;
+    }
 
-    for (Int32 i=0; i < count; i++) {
+    for (Int32 i=0; i < (Int32) graphs.size(); i++) {
         XRealGraph* graph = &graphs[i];
-        graph->SetCount(maxtime - mintime);
+        graph->SetCount(maxtime - mintime + 1);
 
-        GvPort* port = host->GetInPort(i);
-        if (!port) {
+        GvValue* value = values.GetInValue(i);
+        GvPort* in_port = value ? value->GetPort() : nullptr;
+        if (!in_port) {
             continue;
         }
-        graph->port_id = port->GetMainID();
-        GvValue* calcer = host->AllocCalculationHandler(graph->port_id, calc, run, 0);
 
-        // Doesn't work for multiple nodes.
-        if (!calcer->Calculate(host, GV_PORT_INPUT, run, calc)) {
-            GeDebugOut("GvValue::Calculate() failed for port %d.", graph->port_id);
-        }
         Float v;
-        if (port->GetFloat(&v, run)) {
-            graph->StoreRecord(frame, v);
-            run->IncrementID();
+        if (in_port->GetFloat(&v, run)) {
+            graph->StoreRecord(frame - mintime, v);
         }
         else {
             GeDebugOut("!!! Port %d: value could not be retrieved..", graph->port_id);
         }
-        host->FreeCalculationHandler(calcer);
     }
 
     return TRUE;
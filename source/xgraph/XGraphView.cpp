@@ -81,6 +81,7 @@ void XGraphRenderEngine::DrawGraph(GeUserArea* area, const XGraphRect& rect,
 
     XGraphValueState prevstate = XGraphValueState_Empty;
     Float prev = graph->GetValue(display.x_min, &prevstate);
+    Float prev_x = display.x_min;
 
     for (Int32 i=1; i <= width; i++) {
         Float x = ((Float) i / (Float) width) * xrange + display.x_min;
@@ -101,8 +102,19 @@ void XGraphRenderEngine::DrawGraph(GeUserArea* area, const XGraphRect& rect,
             Int32 y2 = rect.y2 - Int32((y - display.y_min) / yrange * height);
 
             area->DrawLine(x1, y1, x2, y2);
+
+            // If multiple values fall into this pixel column, draw their
+            // extent so that no peaks get lost.
+            Float lo, hi;
+            XGraphValueState rstate = XGraphValueState_Empty;
+            if (graph->GetValueRange(prev_x, x, &lo, &hi, &rstate)) {
+                y1 = rect.y2 - Int32((lo - display.y_min) / yrange * height);
+                y2 = rect.y2 - Int32((hi - display.y_min) / yrange * height);
+                area->DrawLine(x2, y1, x2, y2);
+            }
         }
         prev = y;
+        prev_x = x;
         prevstate = state;
     }
 }
@@ -86,6 +86,21 @@
          */
         virtual Float GetValue(Float x, XGraphValueState* state) const = 0;
 
+        /**
+         * Return the minimum and maximum value of the graph in the range
+         * (*x1*, *x2*]. Used by the render engine to draw the extent of
+         * all values that fall into one pixel column instead of sampling
+         * a single value. The default implementation returns FALSE, in
+         * which case only GetValue() is used.
+         *
+         * @return TRUE if the range contains more than one value and
+         *      *y_min* and *y_max* have been assigned, FALSE if not.
+         */
+        virtual Bool GetValueRange(Float x1, Float x2, Float* y_min, Float* y_max,
+                                   XGraphValueState* state) const {
+            return FALSE;
+        }
+
     };
 
     /**
@@ -41,6 +41,7 @@
         // Output parameters.
         Bool* easyOn;
         Vector* easyValues;
+        Int32 easyCount;   // Number of elements in easyValues
 
         XPressoEffector_ExecInfo() { Clean(); }
 
@@ -52,6 +53,7 @@
 
             easyOn = nullptr;
             easyValues = nullptr;
+            easyCount = 0;
         }
 
     };
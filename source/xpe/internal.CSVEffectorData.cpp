@@ -53,6 +53,31 @@ struct RowOperationData {
     const FloatArray* maxv;
 };
 
+/**
+ * Everything the row matrices of the CSV Effector are computed from.
+ * If it does not change between two evaluations, the matrices can be
+ * reused.
+ */
+struct RowMatrixKey {
+    RowConfiguration config;
+    Vector mulPos, mulScale, mulRot;
+    Float minstrength, maxstrength;
+    Int32 count;
+    Int32 tableVersion;
+
+    Bool operator == (const RowMatrixKey& other) const {
+        return config.angle_mode == other.config.angle_mode &&
+            config.pos.x == other.config.pos.x && config.pos.y == other.config.pos.y &&
+            config.pos.z == other.config.pos.z && config.scale.x == other.config.scale.x &&
+            config.scale.y == other.config.scale.y && config.scale.z == other.config.scale.z &&
+            config.rot.x == other.config.rot.x && config.rot.y == other.config.rot.y &&
+            config.rot.z == other.config.rot.z && mulPos == other.mulPos &&
+            mulScale == other.mulScale && mulRot == other.mulRot &&
+            minstrength == other.minstrength && maxstrength == other.maxstrength &&
+            count == other.count && tableVersion == other.tableVersion;
+    }
+};
+
 class CSVEffectorData : public EffectorData {
 
     typedef EffectorData super;
@@ -61,6 +86,9 @@ public:
 
     static NodeData* Alloc() { return NewObjClear(CSVEffectorData); }
 
+    CSVEffectorData()
+    : super(), m_table("xpe.MMFloatCSVTable"), m_tableVersion(0), m_matricesValid(false) { }
+
     //| EffectorData Overrides
 
     virtual void ModifyPoints(BaseObject* op, BaseObject* gen, BaseDocument* doc,
@@ -84,7 +112,30 @@ private:
 
     void UpdateTable(BaseObject* op, BaseDocument* doc=nullptr, BaseContainer* bc=nullptr, Bool force=false);
 
-    MMFloatCSVTable m_table;
+    Bool UpdateMatrices(const RowMatrixKey& key);
+
+    SharedCSVTable<MMFloatCSVTable> m_table;
+
+    /**
+     * Incremented every time the table is reloaded.
+     */
+    Int32 m_tableVersion;
+
+    /**
+     * The matrices computed from the table rows, and the parameters they
+     * have been computed with.
+     */
+    maxon::BaseArray<Matrix> m_matrices;
+    RowMatrixKey m_matricesKey;
+    Bool m_matricesValid;
+
+    /**
+     * The falloff weights of the clones of the current evaluation, and
+     * whether a clone is skipped. Falloffs may produce negative weights,
+     * so skipped clones are flagged separately.
+     */
+    FloatArray m_weights;
+    maxon::BaseArray<Bool> m_skip;
 
 };
 
@@ -96,56 +147,30 @@ void CSVEffectorData::ModifyPoints(
     if (!bc) return;
     UpdateTable(op, doc, bc);
 
-    Int32 rowCount = m_table.GetRowCount();
+    Int32 rowCount = m_table->GetRowCount();
     if (rowCount <= 0) return;
 
     // Retrieve the row-configuration.
     RowConfiguration config;
     GetRowConfiguration(bc, &config);
 
-    // Obtain the number of clones in the MoData and allocate a Matrix
-    // array of such.
+    // Obtain the number of clones in the MoData.
     Int32 cloneCount = md->GetCount();
     if (cloneCount <= 0) return;
-    maxon::BaseArray<Matrix> matrices;
-    (void) matrices.Resize(Min<Int32>(rowCount, cloneCount));
-
-    // Retrieve the mulipliers from the effector parameters.
-    Vector mulPos = bc->GetVector(CSVEFFECTOR_MULTIPLIER_POS);
-    Vector mulScale = bc->GetVector(CSVEFFECTOR_MULTIPLIER_SCALE);
-    Vector mulRot = bc->GetVector(CSVEFFECTOR_MULTIPLIER_ROT);
-    RowOperationData rowOpData;
-    rowOpData.minstrength = data->minstrength;
-    rowOpData.maxstrength = data->maxstrength;
-    rowOpData.minv = &m_table.GetMinValues();
-    rowOpData.maxv = &m_table.GetMaxValues();
-
-    // Modify the matrices based on the CSV data.
-    for (Int32 i=0; i < matrices.GetCount(); i++) {
-        const FloatArray& row = m_table.GetRow(i % rowCount);
-        Matrix& matrix = matrices[i];
-
-        Float h = GetRowCell(rowOpData, row, config.rot.x) * mulRot.x;
-        Float p = GetRowCell(rowOpData, row, config.rot.y) * mulRot.y;
-        Float b = GetRowCell(rowOpData, row, config.rot.z) * mulRot.z;
-        if (config.angle_mode == CSVEFFECTOR_ANGLEMODE_DEGREES) {
-            h = Rad(h);
-            p = Rad(p);
-            b = Rad(b);
-        }
-        matrix = HPBToMatrix(Vector(h, p, b), ROTATIONORDER_DEFAULT);
-
-        Float xScale = GetRowCell(rowOpData, row, config.scale.x, 1.0) * mulScale.x;
-        Float yScale = GetRowCell(rowOpData, row, config.scale.y, 1.0) * mulScale.y;
-        Float zScale = GetRowCell(rowOpData, row, config.scale.z, 1.0) * mulScale.z;
-        Mv1(matrix) *= xScale; // Vector(xScale, 0, 0);
-        Mv2(matrix) *= yScale; // Vector(0, yScale, 0);
-        Mv3(matrix) *= zScale; // Vector(0, 0, zScale);
 
-        Moff(matrix).x = GetRowCell(rowOpData, row, config.pos.x) * mulPos.x;
-        Moff(matrix).y = GetRowCell(rowOpData, row, config.pos.y) * mulPos.y;
-        Moff(matrix).z = GetRowCell(rowOpData, row, config.pos.z) * mulPos.z;
-    }
+    // Compute the matrices from the CSV data, unless they are still
+    // valid from the previous evaluation.
+    RowMatrixKey key;
+    key.config = config;
+    key.mulPos = bc->GetVector(CSVEFFECTOR_MULTIPLIER_POS);
+    key.mulScale = bc->GetVector(CSVEFFECTOR_MULTIPLIER_SCALE);
+    key.mulRot = bc->GetVector(CSVEFFECTOR_MULTIPLIER_ROT);
+    key.minstrength = data->minstrength;
+    key.maxstrength = data->maxstrength;
+    key.count = Min<Int32>(rowCount, cloneCount);
+    key.tableVersion = m_tableVersion;
+    if (!UpdateMatrices(key)) return;
+    const maxon::BaseArray<Matrix>& matrices = m_matrices;
 
     // Retrieve the MD Matrices and additional important information
     // before finally adjusting the clones' matrices.
@@ -195,10 +220,17 @@ void CSVEffectorData::ModifyPoints(
         offset = 0;
     }
 
+    // Sample the weighting of all particles before applying the
+    // changes, and flag the particles that are skipped.
+    iferr (m_weights.Resize(end - start)) return;
+    iferr (m_skip.Resize(end - start)) return;
     Float weight = 0.0;
-
-    // Now apply the changes.
     for (Int32 i=start; i < end; i++) {
+        Float& dest = m_weights[i - start];
+        Bool& skip = m_skip[i - start];
+        dest = 0.0;
+        skip = true;
+
         // Don't calculate the particle if not necessary.
         if (moSelection && !moSelection->IsSelected(i)) continue;
         if (flagArray) {
@@ -208,14 +240,22 @@ void CSVEffectorData::ModifyPoints(
             }
         }
 
-        Matrix mOffset = matrices[(i - start) % matrices.GetCount()];
-        Matrix& mDest  = destMatrices[(i + offset) % cloneCount];
-
-        // Sample the weighting of the current particle.
         if (falloff) {
+            const Matrix& mDest = destMatrices[(i + offset) % cloneCount];
             Float moWeight = weightArray ? weightArray[i] : 1.0;
             falloff->Sample((mDest * mParent).off, &weight, true, moWeight);
         }
+        dest = weight;
+        skip = false;
+    }
+
+    // Now apply the changes.
+    for (Int32 i=start; i < end; i++) {
+        if (m_skip[i - start]) continue;
+        weight = m_weights[i - start];
+
+        Matrix mOffset = matrices[(i - start) % matrices.GetCount()];
+        Matrix& mDest  = destMatrices[(i + offset) % cloneCount];
 
         // The offset matrix is relative to the particles matrix. Make it absolute.
         /*mOffset.off += mDest.off;
@@ -302,7 +342,7 @@ Bool CSVEffectorData::Message(GeListNode* node, Int32 type, void* pData) {
         case CSVEFFECTOR_HASHEADER:
         case CSVEFFECTOR_FILENAME:
         case CSVEFFECTOR_DELIMITER:
-            UpdateTable((BaseObject*) node, nullptr, nullptr, true);
+            UpdateTable((BaseObject*) node);
             break;
         default:
             break;
@@ -315,6 +355,51 @@ Bool CSVEffectorData::Message(GeListNode* node, Int32 type, void* pData) {
     return super::Message(node, type, pData);
 }
 
+Bool CSVEffectorData::UpdateMatrices(const RowMatrixKey& key) {
+    if (m_matricesValid && m_matricesKey == key) return true;
+    m_matricesValid = false;
+    iferr (m_matrices.Resize(key.count)) return false;
+
+    const RowConfiguration& config = key.config;
+    Int32 rowCount = m_table->GetRowCount();
+    RowOperationData rowOpData;
+    rowOpData.minstrength = key.minstrength;
+    rowOpData.maxstrength = key.maxstrength;
+    rowOpData.minv = &m_table->GetMinValues();
+    rowOpData.maxv = &m_table->GetMaxValues();
+
+    // Modify the matrices based on the CSV data.
+    for (Int32 i=0; i < m_matrices.GetCount(); i++) {
+        const FloatArray& row = m_table->GetRow(i % rowCount);
+        Matrix& matrix = m_matrices[i];
+
+        Float h = GetRowCell(rowOpData, row, config.rot.x) * key.mulRot.x;
+        Float p = GetRowCell(rowOpData, row, config.rot.y) * key.mulRot.y;
+        Float b = GetRowCell(rowOpData, row, config.rot.z) * key.mulRot.z;
+        if (config.angle_mode == CSVEFFECTOR_ANGLEMODE_DEGREES) {
+            h = Rad(h);
+            p = Rad(p);
+            b = Rad(b);
+        }
+        matrix = HPBToMatrix(Vector(h, p, b), ROTATIONORDER_DEFAULT);
+
+        Float xScale = GetRowCell(rowOpData, row, config.scale.x, 1.0) * key.mulScale.x;
+        Float yScale = GetRowCell(rowOpData, row, config.scale.y, 1.0) * key.mulScale.y;
+        Float zScale = GetRowCell(rowOpData, row, config.scale.z, 1.0) * key.mulScale.z;
+        Mv1(matrix) *= xScale; // Vector(xScale, 0, 0);
+        Mv2(matrix) *= yScale; // Vector(0, yScale, 0);
+        Mv3(matrix) *= zScale; // Vector(0, 0, zScale);
+
+        Moff(matrix).x = GetRowCell(rowOpData, row, config.pos.x) * key.mulPos.x;
+        Moff(matrix).y = GetRowCell(rowOpData, row, config.pos.y) * key.mulPos.y;
+        Moff(matrix).z = GetRowCell(rowOpData, row, config.pos.z) * key.mulPos.z;
+    }
+
+    m_matricesKey = key;
+    m_matricesValid = true;
+    return true;
+}
+
 void CSVEffectorData::GetRowConfiguration(const BaseContainer* bc, RowConfiguration* config) {
     config->pos.x = bc->GetInt32(CSVEFFECTOR_ASSIGNMENT_XPOS);
     config->pos.y = bc->GetInt32(CSVEFFECTOR_ASSIGNMENT_YPOS);
@@ -339,7 +424,7 @@ Float CSVEffectorData::GetRowCell(const RowOperationData& data, const FloatArray
 
 void CSVEffectorData::FillCycleParameter(BaseContainer* itemdesc) {
     if (!itemdesc) return;
-    const BaseContainer& ref = m_table.GetHeaderContainer();
+    const BaseContainer& ref = m_table->GetHeaderContainer();
     itemdesc->SetContainer(DESC_CYCLE, ref);
 }
 
@@ -353,8 +438,6 @@ void CSVEffectorData::UpdateTable(BaseObject* op, BaseDocument* doc, BaseContain
     if (delimiter < 0 || delimiter > 255) {
         delimiter = CSVEFFECTOR_DELIMITER_COMMA;
     }
-    m_table.SetDelimiter((Char) delimiter);
-    m_table.SetHasHeader(bc->GetBool(CSVEFFECTOR_HASHEADER));
 
     // Retrieve the filename and make it relative if it does not
     // exist the way it was retrieved.
@@ -364,16 +447,20 @@ void CSVEffectorData::UpdateTable(BaseObject* op, BaseDocument* doc, BaseContain
     }
 
     Bool updated = false;
-    Bool success = m_table.Init(filename, force, &updated);
+    Bool header = bc->GetBool(CSVEFFECTOR_HASHEADER);
+    Bool success = m_table.Init(filename, (Char) delimiter, header, force, &updated);
     if (updated) {
+        // Invalidate the matrices computed from the previous table.
+        m_tableVersion++;
+
         // The description must be reloaded if the table did update.
         op->SetDirty(DIRTYFLAGS_DESCRIPTION);
 
         // Update the statistics information in the effector parameters.
         String stats;
-        if (m_table.Loaded()) {
-            String rowCnt = String::IntToString(m_table.GetRowCount());
-            String colCnt = String::IntToString(m_table.GetColumnCount());
+        if (m_table->Loaded()) {
+            String rowCnt = String::IntToString(m_table->GetRowCount());
+            String colCnt = String::IntToString(m_table->GetColumnCount());
             stats = GeLoadString(IDC_CSVEFFECTOR_STATS_FORMAT, rowCnt, colCnt);
         }
         else if (success) {
@@ -385,7 +472,7 @@ void CSVEffectorData::UpdateTable(BaseObject* op, BaseDocument* doc, BaseContain
         bc->SetString(CSVEFFECTOR_STATS, stats);
     }
     else if (!success) {
-        GePrint("No success initializing CSV file: " + String::IntToString(m_table.GetLastError()));
+        GePrint("No success initializing CSV file: " + String::IntToString(m_table->GetLastError()));
     }
 }
 
@@ -14,6 +14,7 @@
  * language governing permissions and limitations under the License.
  */
 
+#include <atomic>
 #include <c4d_apibridge.h>
 #include <c4d_operatordata.h>
 #include "lib_csv.h"
@@ -112,7 +113,7 @@ public:
     static NodeData* Alloc() { return NewObjClear(CSVNodeData); }
 
     CSVNodeData()
-    : super(), m_forceUpdate(true), m_pHeader(false), m_pDelimiter(0) { }
+    : super(), m_table("xpe.ColumnCSVTable"), m_portsStale(false) { }
 
     //| GvOperatorData Overrides
 
@@ -134,11 +135,11 @@ public:
 
     virtual Bool Init(GeListNode* node);
 
-    virtual Bool Message(GeListNode* node, Int32 type, void* pData);
-
     virtual Bool GetDEnabling(GeListNode* node, const DescID& id, const GeData& t_data,
             DESCFLAGS_ENABLE flags, const BaseContainer* itemdesc);
 
+    virtual Bool Message(GeListNode* node, Int32 type, void* pData);
+
 private:
 
     void AddPort(GvNode* node, Int32 mainId) const;
@@ -147,19 +148,32 @@ private:
 
     Bool UpdateCSVTable(GvNode* node, GvRun* run, GvCalc* calc);
 
+    /**
+     * Returns the GV data type of the output port for the specified
+     * column. Always #DTYPE_STRING if *typed* is false.
+     */
+    Int32 GetColumnDataType(Int32 column, Bool typed) const;
+
+    /**
+     * Replaces the column output ports whose value type does not match
+     * the type from #GetColumnDataType() anymore, and restores their
+     * outgoing connections. Must be called from the main thread.
+     */
+    void RetypeColumnPorts(GvNode* node);
+
     // Full life-cycle members
-    StringCSVTable m_table;
-    Bool m_forceUpdate;
+    SharedCSVTable<ColumnCSVTable> m_table;
+
+    // Set when the column types or the typed ports option changed, and
+    // the column ports may need to be retyped. Set during the calculation
+    // and consumed on the main thread.
+    std::atomic<bool> m_portsStale;
 
     // Calculation members
     GvValuesInfo m_values;
     Bool m_calcInit;
     Bool m_initCsv;
 
-    // Previous values to check if an update is required.
-    Bool m_pHeader;
-    Int32 m_pDelimiter;
-
 };
 
 Bool CSVNodeData::iCreateOperator(GvNode* node) {
@@ -187,12 +201,14 @@ Bool CSVNodeData::iGetPortDescription(GvNode* host, GvPortIO port, Int32 id,
             break;
         }
     }
-    if (!result && id >= CSVNODE_DYNPORT_START && m_table.Loaded()) {
+    if (!result && id >= CSVNODE_DYNPORT_START && m_table->Loaded()) {
         Int32 index = id - CSVNODE_DYNPORT_START;
-        Int32 colCount = m_table.GetColumnCount();
+        Int32 colCount = m_table->GetColumnCount();
         if (index < colCount) {
+            GeData typed;
+            host->GetParameter(CSVNODE_TYPEDPORTS, typed, DESCFLAGS_GET_0);
             desc->name = GetTableColumnPortName(index);
-            desc->data_id = DTYPE_STRING;
+            desc->data_id = GetColumnDataType(index, typed.GetBool());
             desc->flags = GV_PORTDESCRIPTION_NONE;
             result = true;
         }
@@ -248,8 +264,8 @@ Int32 CSVNodeData::FillPortsMenu(GvNode* node, BaseContainer& names, BaseContain
     }
 
     // Add the CSV Table's output ports.
-    if (flag == GV_PORT_OUTPUT && m_table.Loaded()) {
-        Int32 colCount = m_table.GetColumnCount();
+    if (flag == GV_PORT_OUTPUT && m_table->Loaded()) {
+        Int32 colCount = m_table->GetColumnCount();
         GeData forceCols, forceColsCount;
         node->GetParameter(CSVNODE_FORCEOUTPORTS, forceCols, DESCFLAGS_GET_0);
         node->GetParameter(CSVNODE_FORCEOUTPORTS_COUNT, forceColsCount, DESCFLAGS_GET_0);
@@ -311,10 +327,10 @@ Bool CSVNodeData::Calculate(GvNode* node, GvPort* port, GvRun* run, GvCalc* calc
     }
 
     // Obtain the row from the CSV Table that is to be used.
-    const StringCSVTable::Array* row = nullptr;
-    Int32 rowCount = m_table.GetRowCount();
+    const ColumnCSVTable::Array* row = nullptr;
+    Int32 rowCount = m_table->GetRowCount();
     if (rowIndex >= 0 && rowIndex < rowCount) {
-        row = &m_table.GetRow(rowIndex);
+        row = &m_table->GetRow(rowIndex);
     }
 
     // True when setting the outgoing value for the port was
@@ -326,10 +342,10 @@ Bool CSVNodeData::Calculate(GvNode* node, GvPort* port, GvRun* run, GvCalc* calc
     Int32 portId = port->GetMainID();
     switch (portId) {
     case CSVNODE_LOADED:
-        port->SetBool(m_table.Loaded(), run);
+        port->SetBool(m_table->Loaded(), run);
         break;
     case CSVNODE_COLCOUNT_TOTAL:
-        port->SetInteger(m_table.GetColumnCount(), run);
+        port->SetInteger(m_table->GetColumnCount(), run);
         break;
     case CSVNODE_COLCOUNT: {
         Int32 count = row ? row->GetCount() : 0;
@@ -337,7 +353,7 @@ Bool CSVNodeData::Calculate(GvNode* node, GvPort* port, GvRun* run, GvCalc* calc
         break;
     }
     case CSVNODE_ROWCOUNT:
-        port->SetInteger(m_table.GetRowCount(), run);
+        port->SetInteger(m_table->GetRowCount(), run);
         break;
     default:
         result = false;
@@ -348,14 +364,27 @@ Bool CSVNodeData::Calculate(GvNode* node, GvPort* port, GvRun* run, GvCalc* calc
     // a CSV column.
     if (!result && portId >= CSVNODE_DYNPORT_START) {
         Int32 index = portId - CSVNODE_DYNPORT_START;
-        Int32 colCount = m_table.GetColumnCount();
-
-        String value = "";
-        if (index >= 0 && index < colCount && row) {
-            value = (*row)[index];
+        Int32 colCount = m_table->GetColumnCount();
+        Bool valid = index >= 0 && index < colCount && row;
+
+        // The port keeps its type until it is retyped on the main thread,
+        // so the value is converted to the type the port actually has.
+        switch (port->GetValueType()) {
+        case ID_GV_VALUE_TYPE_INTEGER:
+            port->SetInteger(valid ? (Int32) m_table->GetNumber(rowIndex, index) : 0, run);
+            break;
+        case ID_GV_VALUE_TYPE_REAL:
+            port->SetFloat(valid ? m_table->GetNumber(rowIndex, index) : 0.0, run);
+            break;
+        default: {
+            String value = "";
+            if (valid && index < row->GetCount()) {
+                value = (*row)[index];
+            }
+            port->SetString(value, run);
+            break;
+        }
         }
-
-        port->SetString(value, run);
         result = true;
     }
 
@@ -368,6 +397,10 @@ Bool CSVNodeData::Init(GeListNode* node) {
     node->SetParameter(CSVNODE_FORCEOUTPORTS, Bool(false), DESCFLAGS_SET_0);
     node->SetParameter(CSVNODE_FORCEOUTPORTS_COUNT, Int32(0), DESCFLAGS_SET_0);
 
+    // Nodes from older scenes don't have this parameter and will keep
+    // their String ports, new nodes output numeric columns as numbers.
+    node->SetParameter(CSVNODE_TYPEDPORTS, Bool(true), DESCFLAGS_SET_0);
+
     // Can't initialize with container, need to use SetParameter.
     node->SetParameter(CSVNODE_FILENAME, Filename(""), DESCFLAGS_SET_0);
     node->SetParameter(CSVNODE_HEADER, true, DESCFLAGS_SET_0);
@@ -376,28 +409,6 @@ Bool CSVNodeData::Init(GeListNode* node) {
     return true;
 }
 
-Bool CSVNodeData::Message(GeListNode* gNode, Int32 type, void* pData)  {
-    if (!gNode) return false;
-    GvNode* node = (GvNode*) gNode;
-    switch (type) {
-    case MSG_DESCRIPTION_POSTSETPARAMETER: {
-        DescriptionPostSetValue* data = (DescriptionPostSetValue*) pData;
-        if (!data) return false;
-        Int32 id = (*data->descid)[data->descid->GetDepth() - 1].id;
-
-        switch (id) {
-        case CSVNODE_FILENAME:
-        case CSVNODE_HEADER:
-        case CSVNODE_DELIMITER:
-            m_forceUpdate = true;
-            break;
-        } // end switch
-        break;
-    }
-    } // end switch
-    return super::Message(node, type, pData);
-}
-
 Bool CSVNodeData::GetDEnabling(GeListNode* node, const DescID& id, const GeData& t_data,
             DESCFLAGS_ENABLE flags, const BaseContainer* itemdesc) {
     if (id == CSVNODE_FORCEOUTPORTS_COUNT) {
@@ -409,6 +420,22 @@ Bool CSVNodeData::GetDEnabling(GeListNode* node, const DescID& id, const GeData&
     return super::GetDEnabling(node, id, t_data, flags, itemdesc);
 }
 
+Bool CSVNodeData::Message(GeListNode* node, Int32 type, void* pData) {
+    if (type == MSG_DESCRIPTION_POSTSETPARAMETER && pData) {
+        DescriptionPostSetValue* data = (DescriptionPostSetValue*) pData;
+        if (data->descid && (*data->descid)[0].id == CSVNODE_TYPEDPORTS) {
+            m_portsStale = true;
+        }
+    }
+
+    // Ports can only be changed safely from the main thread, the table
+    // however is loaded during the calculation.
+    if (node && GeIsMainThread() && m_portsStale.exchange(false)) {
+        RetypeColumnPorts(static_cast<GvNode*>(node));
+    }
+    return super::Message(node, type, pData);
+}
+
 void CSVNodeData::AddPort(GvNode* node, Int32 mainId) const {
     if (!node) return;
     const CSVPort* port = nullptr;
@@ -453,21 +480,10 @@ Bool CSVNodeData::UpdateCSVTable(GvNode* node, GvRun* run, GvCalc* calc) {
     // further initialization in the calculation cycle.
     m_initCsv = true;
 
-    // Validate and set the data to the CSV Table object.
-    if (m_pHeader != header) {
-        m_forceUpdate = true;
-    }
-    m_pHeader = header;
-    m_table.SetHasHeader(header);
-
+    // Validate the delimiter.
     if (delimiter < 0 || delimiter > 255) {
         delimiter = CSVNODE_DELIMITER_COMMA;
     }
-    if (m_pDelimiter != delimiter) {
-        m_forceUpdate = true;
-    }
-    m_pDelimiter = delimiter;
-    m_table.SetDelimiter((Char) delimiter);
 
     // Make the CSV Filename relative to the node's document if the file
     // does not exist.
@@ -475,21 +491,96 @@ Bool CSVNodeData::UpdateCSVTable(GvNode* node, GvRun* run, GvCalc* calc) {
         filename = doc->GetDocumentPath() + filename;
     }
 
-    // Update the CSV Table.
+    // Update the CSV Table. It is shared with all other nodes that read
+    // the same file with the same settings.
     Bool updated = false;
-    Bool success = m_table.Init(filename, m_forceUpdate, &updated);
-    m_forceUpdate = false;
+    Bool success = m_table.Init(filename, (Char) delimiter, header, false, &updated);
+    if (updated) m_portsStale = true;
 
     return success;
 }
 
+Int32 CSVNodeData::GetColumnDataType(Int32 column, Bool typed) const {
+    if (!typed) return DTYPE_STRING;
+    switch (m_table->GetColumnType(column)) {
+    case CSVColumnType_Int: return DTYPE_LONG;
+    case CSVColumnType_Float: return DTYPE_REAL;
+    default: return DTYPE_STRING;
+    }
+}
+
+/**
+ * Calls *func* for every node in the hierarchy starting at *node*.
+ */
+template <typename F>
+static void IterNodes(GvNode* node, F&& func) {
+    for (; node; node = node->GetNext()) {
+        func(node);
+        IterNodes(node->GetDown(), func);
+    }
+}
+
+void CSVNodeData::RetypeColumnPorts(GvNode* node) {
+    GvNodeMaster* master = node->GetNodeMaster();
+    GvWorld* world = GvGetWorld();
+    if (!master || !world || !m_table->Loaded()) return;
+
+    GeData typed;
+    node->GetParameter(CSVNODE_TYPEDPORTS, typed, DESCFLAGS_GET_0);
+
+    // Collect the IDs of the column ports that have the wrong type.
+    maxon::BaseArray<Int32> stale;
+    Int32 count = node->GetOutPortCount();
+    for (Int32 i=0; i < count; i++) {
+        GvPort* port = node->GetOutPort(i);
+        if (!port || port->GetMainID() < CSVNODE_DYNPORT_START) continue;
+        Int32 dtype = GetColumnDataType(port->GetMainID() - CSVNODE_DYNPORT_START, typed.GetBool());
+        GvDataInfo* info = world->GetDataTypeInfo(dtype);
+        if (!info || info->value_handler->value_id == port->GetValueType()) continue;
+        iferr (stale.Append(port->GetMainID())) return;
+    }
+
+    struct Connection {
+        GvNode* node;
+        GvPort* port;
+    };
+
+    for (Int32 portId : stale) {
+        GvPort* port = node->GetOutPortFirstMainID(portId);
+        if (!port) continue;
+
+        // Remember the in-ports that the port is connected to.
+        maxon::BaseArray<Connection> connections;
+        Bool ok = true;
+        IterNodes(master->GetRoot(), [&](GvNode* dest) {
+            Int32 inCount = dest->GetInPortCount();
+            for (Int32 j=0; ok && j < inCount; j++) {
+                GvPort* destPort = dest->GetInPort(j);
+                GvNode* srcNode = nullptr;
+                GvPort* srcPort = nullptr;
+                if (destPort && destPort->GetIncomingSource(srcNode, srcPort) && srcPort == port) {
+                    iferr (connections.Append(Connection{dest, destPort})) ok = false;
+                }
+            }
+        });
+        if (!ok) continue;
+
+        node->RemovePort(port, true);
+        port = node->AddPort(GV_PORT_OUTPUT, portId, GV_PORT_FLAG_IS_VISIBLE, true);
+        if (!port) continue;
+        for (const Connection& conn : connections) {
+            node->AddConnection(node, port, conn.node, conn.port);
+        }
+    }
+}
+
 String CSVNodeData::GetTableColumnPortName(Int32 column) const {
-    if (!m_table.Loaded() || column < 0) {
+    if (!m_table->Loaded() || column < 0) {
         return GeLoadString(IDC_CSVNODE_INVALIDPORT);
     }
 
     String prefix = GeLoadString(IDC_CSVNODE_TABLECOLUMN_PREFIX);
-    const CSVRow& header = m_table.GetHeader();
+    const CSVRow& header = m_table->GetHeader();
 
     if (column < header.GetCount()) {
         return prefix + header[column];
@@ -179,9 +179,24 @@ public:
 
     virtual ~MoPortHandler() { }
 
-    virtual Bool MDToPort(GvPort* port, GvRun* run, MoData* md, Int32 index) = 0;
+    /**
+     * Returns the MoData array of the handler, adding it to the MoData
+     * if it does not exist. The returned pointer can be passed to the
+     * array versions of `MDToPort()` and `PortToMD()`, it may be nullptr.
+     */
+    virtual void* GetArray(MoData* md) = 0;
+
+    virtual Bool MDToPort(GvPort* port, GvRun* run, void* array, Int32 index) = 0;
+
+    virtual Bool PortToMD(GvPort* port, GvRun* run, void* array, Int32 index) = 0;
+
+    Bool MDToPort(GvPort* port, GvRun* run, MoData* md, Int32 index) {
+        return MDToPort(port, run, GetArray(md), index);
+    }
 
-    virtual Bool PortToMD(GvPort* port, GvRun* run, MoData* md, Int32 index) = 0;
+    Bool PortToMD(GvPort* port, GvRun* run, MoData* md, Int32 index) {
+        return PortToMD(port, run, GetArray(md), index);
+    }
 
     Int32 GetId() const { return m_dataId; }
 
@@ -225,16 +240,21 @@ public:
 
     //| MoPortHandler Overrides
 
-    virtual Bool MDToPort(GvPort* port, GvRun* run, MoData* md, Int32 index) {
-        T* array = EnsureArray(md);
+    using MoPortHandler::MDToPort;
+    using MoPortHandler::PortToMD;
+
+    virtual void* GetArray(MoData* md) {
+        return EnsureArray(md);
+    }
+
+    virtual Bool MDToPort(GvPort* port, GvRun* run, void* array, Int32 index) {
         if (!array) return iMDToPort(port, run, &m_default, 0);
-        else return iMDToPort(port, run, array, index);
+        else return iMDToPort(port, run, (T*) array, index);
     }
 
-    virtual Bool PortToMD(GvPort* port, GvRun* run, MoData* md, Int32 index) {
-        T* array = EnsureArray(md);
+    virtual Bool PortToMD(GvPort* port, GvRun* run, void* array, Int32 index) {
         if (!array) return false;
-        else return iPortToMD(port, run, array, index);
+        else return iPortToMD(port, run, (T*) array, index);
     }
 
 protected:
@@ -527,11 +547,21 @@ public:
         if (!GvBuildValuesTable(node, m_values, calc, run, GV_EXISTING_PORTS)) {
             return false;
         }
+
+        // The MoData arrays and falloff weights are resolved on first
+        // use and stay valid for the whole calculation.
+        m_arrays = ArrayCache();
+        m_falloffWeights.Flush();
+        m_falloffValid = false;
+        m_easyMode = GetEasyMode(node);
         return super::InitCalculation(node, calc, run);
     }
 
     virtual void FreeCalculation(GvNode* node, GvCalc* calc) {
         GvFreeValuesTable(node, m_values);
+        m_arrays = ArrayCache();
+        m_falloffWeights.Flush();
+        m_falloffValid = false;
         super::FreeCalculation(node, calc);
     }
 
@@ -603,11 +633,15 @@ public:
                 case MODATANODE_FALLOFF: {
                     Float value = 1.0;
                     if (falloff) {
-                        MDArray<Matrix> matArray = md->GetMatrixArray(MODATA_MATRIX);
-                        MDArray<Float> weightArray = md->GetRealArray(MODATA_WEIGHT);
-
-                        Matrix mat = gen->GetMg() * (matArray ? matArray[cloneIndex] : Matrix());
-                        falloff->Sample(mat.off, &value, true, 0.0);
+                        const Float* weights = GetFalloffWeights(md, gen, falloff);
+                        if (weights) {
+                            value = weights[cloneIndex];
+                        }
+                        else {
+                            MDArray<Matrix> matArray = md->GetMatrixArray(MODATA_MATRIX);
+                            Matrix mat = gen->GetMg() * (matArray ? matArray[cloneIndex] : Matrix());
+                            falloff->Sample(mat.off, &value, true, 0.0);
+                        }
                     }
                     return outPort->SetFloat(value, run);
                 }
@@ -638,6 +672,44 @@ public:
 
 private:
 
+    typedef c4d_apibridge::HashMap<Int32, void*> ArrayCache;
+
+    /**
+     * Returns the MoData array of *handler*, resolved only once per
+     * calculation.
+     */
+    void* GetCachedArray(MoPortHandler* handler, MoData* md) {
+        maxon::Bool created = false;
+        auto entry = m_arrays.FindOrCreateEntry(handler->GetId(), created);
+        if (!entry) return handler->GetArray(md);
+        if (created) entry->GetValue() = handler->GetArray(md);
+        return entry->GetValue();
+    }
+
+    /**
+     * Samples the falloff for all clones at once on first use in a
+     * calculation. Returns nullptr if the weights could not be
+     * allocated.
+     */
+    const Float* GetFalloffWeights(MoData* md, BaseObject* gen, C4D_Falloff* falloff) {
+        if (m_falloffValid) return m_falloffWeights.GetFirst();
+        Int32 count = md->GetCount();
+        iferr (m_falloffWeights.Resize(count)) {
+            m_falloffWeights.Flush();
+            return nullptr;
+        }
+        MDArray<Matrix> matArray = md->GetMatrixArray(MODATA_MATRIX);
+        Matrix genMg = gen->GetMg();
+        for (Int32 i=0; i < count; i++) {
+            Matrix mat = genMg * (matArray ? matArray[i] : Matrix());
+            Float value = 1.0;
+            falloff->Sample(mat.off, &value, true, 0.0);
+            m_falloffWeights[i] = value;
+        }
+        m_falloffValid = true;
+        return m_falloffWeights.GetFirst();
+    }
+
     Bool GetEasyMode(GvNode* node) {
         GeData gEasyMode;
         node->GetParameter(MODATANODE_EASYMODE, gEasyMode, DESCFLAGS_GET_0);
@@ -650,7 +722,8 @@ private:
         Int32 handlerId = MoDataIdToHandlerId(mainId);
 
         // If we are in easy mode, we want to use the weight-sub ports.
-        if (GetEasyMode(node) && m_execInfo.easyValues && mainId == MODATANODE_EASYWEIGHT) {
+        if (m_easyMode && m_execInfo.easyValues && mainId == MODATANODE_EASYWEIGHT) {
+            if (index < 0 || index >= m_execInfo.easyCount) return false;
             Vector* value = m_execInfo.easyValues + index;
             return port->GetVector(value, run);
         }
@@ -663,7 +736,7 @@ private:
 
         switch (mainId) {
             case MODATA_SIZE: {
-                Matrix* matrices = ((AwesomeMoPortHandler<Matrix>*) handler)->EnsureArray(md);
+                Matrix* matrices = (Matrix*) GetCachedArray(handler, md);
                 if (matrices) {
                     Matrix& mat = matrices[index];
                     Vector size;
@@ -677,7 +750,7 @@ private:
                 break;
             }
             default:
-                return handler->PortToMD(port, run, md, index);
+                return handler->PortToMD(port, run, GetCachedArray(handler, md), index);
         }
         return false;
     }
@@ -694,7 +767,7 @@ private:
 
         switch (mainId) {
             case MODATA_SIZE: {
-                Matrix* matrices = ((AwesomeMoPortHandler<Matrix>*) handler)->EnsureArray(md);
+                Matrix* matrices = (Matrix*) GetCachedArray(handler, md);
                 if (matrices) {
                     using namespace c4d_apibridge::M;
                     Matrix& mat = matrices[index];
@@ -707,7 +780,7 @@ private:
                 break;
             }
             default:
-                return handler->MDToPort(port, run, md, index);
+                return handler->MDToPort(port, run, GetCachedArray(handler, md), index);
         }
         return false;
     }
@@ -733,6 +806,12 @@ private:
     XPressoEffector_ExecInfo m_execInfo;
     GvValuesInfo m_values;
 
+    // Per-calculation caches, reset in InitCalculation().
+    ArrayCache m_arrays;
+    maxon::BaseArray<Float> m_falloffWeights;
+    Bool m_falloffValid = false;
+    Bool m_easyMode = false;
+
 };
 
 const Vector MoDataNodeData::c_wrongBodyColor = Vector(1.0, 0.2, 0.05);
@@ -16,6 +16,7 @@
  * TODO: Make Effector dirty when Tag changed.
  */
 
+#include <atomic>
 #include <c4d_graphview.h>
 #include <customgui_inexclude.h>
 #include <NiklasRosenstein/c4d/cleanup.hpp>
@@ -49,6 +50,137 @@ static BaseTag* GetPresetTag() {
     else return BaseTag::Alloc(Texpresso);
 }
 
+/**
+ * Caches links to the XPresso tags of an object and the summed
+ * dirty-count of these tags. The list is only collected again when the
+ * tag hierarchy of the object changed, so that computing the dirty-count
+ * of the tags does not require to walk over all tags of the object. The
+ * tags are referenced by BaseLinks and every linked tag is checked to
+ * still be on the object before it is used.
+ *
+ * The tags are only visited by #Update(), which is called from
+ * Execute(). #GetDirty() is called from Message(), possibly on another
+ * thread, and only reads the dirty-count stored by the last #Update().
+ */
+class XPressoTagTracker {
+
+public:
+
+    XPressoTagTracker() : m_hdirty(0), m_valid(false), m_cache(0) { }
+
+    ~XPressoTagTracker() { _Flush(); }
+
+    /**
+     * Returns the dirty-count of all XPresso tags on *op* and their
+     * node masters as computed by the last #Update(). If the tag
+     * hierarchy of *op* changed since then, the tags are counted
+     * directly.
+     */
+    Int32 GetDirty(BaseObject* op) const {
+        UInt64 const cache = m_cache.load(std::memory_order_acquire);
+        UInt32 const hdirty = op->GetHDirty(HDIRTYFLAGS_TAG);
+        if ((cache >> 32) == (UInt64) hdirty + 1) return (Int32) (UInt32) cache;
+        return _CountDirty(op);
+    }
+
+    /**
+     * Computes the dirty-count of all XPresso tags on *op* and their
+     * node masters and stores it for #GetDirty(). Must not be called
+     * from multiple threads at once.
+     */
+    Int32 Update(BaseObject* op) {
+        UInt32 const hdirty = op->GetHDirty(HDIRTYFLAGS_TAG);
+        Int32 dcnt = 0;
+        if (_Update(op, hdirty)) {
+            for (BaseLink* link : m_links) {
+                BaseTag* tag = _Resolve(link, op);
+                if (!tag) {
+                    // The tag was removed or moved without the tag hierarchy
+                    // dirty-count being changed.
+                    _Flush();
+                    break;
+                }
+                dcnt += _TagDirty(tag);
+            }
+        }
+        if (!m_valid) {
+            m_cache.store(0, std::memory_order_release);
+            return _CountDirty(op);
+        }
+        // The hierarchy dirty-count is stored incremented by one so that
+        // an empty cache never matches.
+        UInt64 const cache = (((UInt64) hdirty + 1) << 32) | (UInt32) dcnt;
+        m_cache.store(cache, std::memory_order_release);
+        return dcnt;
+    }
+
+private:
+
+    static Int32 _TagDirty(BaseTag* tag) {
+        Int32 dcnt = tag->GetDirty(DIRTYFLAGS_ALL) + tag->GetHDirty(HDIRTYFLAGS_ALL);
+        GvNodeMaster* master = static_cast<XPressoTag*>(tag)->GetNodeMaster();
+        if (master) dcnt += master->GetDirty(DIRTYFLAGS_ALL) + master->GetHDirty(HDIRTYFLAGS_ALL);
+        return dcnt;
+    }
+
+    static BaseTag* _Resolve(BaseLink* link, BaseObject* op) {
+        BaseList2D* node = link->ForceGetLink();
+        if (!node || !node->IsInstanceOf(Texpresso)) return nullptr;
+        BaseTag* tag = static_cast<BaseTag*>(node);
+        if (tag->GetObject() != op) return nullptr;
+        return tag;
+    }
+
+    Bool _Update(BaseObject* op, UInt32 hdirty) {
+        if (m_valid && hdirty == m_hdirty) return true;
+        _Flush();
+        for (BaseTag* tag=op->GetFirstTag(); tag; tag=tag->GetNext()) {
+            if (tag->IsInstanceOf(Texpresso)) {
+                BaseLink* link = BaseLink::Alloc();
+                if (!link) {
+                    _Flush();
+                    return false;
+                }
+                link->SetLink(tag);
+                iferr (m_links.Append(link)) {
+                    BaseLink::Free(link);
+                    _Flush();
+                    return false;
+                }
+            }
+        }
+        m_hdirty = hdirty;
+        m_valid = true;
+        return true;
+    }
+
+    void _Flush() {
+        for (BaseLink* link : m_links) BaseLink::Free(link);
+        m_links.Flush();
+        m_valid = false;
+    }
+
+    static Int32 _CountDirty(BaseObject* op) {
+        Int32 dcnt = 0;
+        for (BaseTag* tag=op->GetFirstTag(); tag; tag=tag->GetNext()) {
+            if (tag->IsInstanceOf(Texpresso)) dcnt += _TagDirty(tag);
+        }
+        return dcnt;
+    }
+
+    maxon::BaseArray<BaseLink*> m_links;
+    UInt32 m_hdirty;
+    Bool m_valid;
+
+    /**
+     * The tag hierarchy dirty-count plus one in the upper and the
+     * summed dirty-count in the lower 32 bits, so that both are read
+     * and written together.
+     */
+    std::atomic<UInt64> m_cache;
+
+};
+
 class XPressoEffectorData : public EffectorData {
 
     typedef EffectorData super;
@@ -93,8 +225,8 @@ public:
 
         Bool easyOn = false;
         m_execInfo.easyOn = &easyOn;
-        iferr (m_execInfo.easyValues = NewMemClear(Vector, md->GetCount()))
-            ;
+        m_execInfo.easyValues = _PrepareEasyValues(md->GetCount());
+        m_execInfo.easyCount = m_execInfo.easyValues ? md->GetCount() : 0;
         if (!m_execInfo.easyValues) {
             GePrint(String(__FUNCTION__) + ": Failed to create easy values array.");
         }
@@ -111,7 +243,6 @@ public:
             super::ModifyPoints(op, gen, doc, data, md, thread);
         }
 
-        if (m_execInfo.easyValues) DeleteMem(m_execInfo.easyValues);
         m_execInfo.Clean();
     }
 
@@ -165,7 +296,8 @@ public:
     virtual Bool Message(GeListNode* node, Int32 type, void* pData) {
         if (!node) return false;
 
-        // Calculate the dirty-count of all XPresso tags on the object.
+        // Retrieve the dirty-count of all XPresso tags on the object, as
+        // computed by the last Execute().
         Int32 dcnt = _CountXPressoTagsDirty(static_cast<BaseObject*>(node));
 
         // If the calculated dirty-count differs from the stored count,
@@ -220,6 +352,27 @@ public:
 
 private:
 
+    /**
+     * Returns the buffer for the easy values of *count* clones, all set
+     * to zero. The buffer is kept across evaluations and only grows, so
+     * no memory is allocated as long as the clone count does not
+     * increase.
+     */
+    Vector* _PrepareEasyValues(Int32 count) {
+        if (count <= 0) return nullptr;
+        if (m_easyValues.GetCount() < count) {
+            iferr (m_easyValues.Resize(count)) {
+                m_easyValues.Reset();
+                return nullptr;
+            }
+        }
+        Vector* values = m_easyValues.GetFirst();
+        for (Int32 i=0; i < count; i++) {
+            values[i] = Vector();
+        }
+        return values;
+    }
+
     Bool _UpdateDependencies(BaseObject* op, BaseDocument* doc) {
         if (!op) return false;
 
@@ -247,8 +400,9 @@ private:
             }
         }
 
-        // Add the dirty-count of all XPresso Tags.
-        dcount += _CountXPressoTagsDirty(op);
+        // Add the dirty-count of all XPresso Tags. This also updates the
+        // dirty-count that Message() compares against.
+        dcount += m_tags.Update(op);
 
         // Compare the dirty-counts.
         if (dcount != m_d_dcount) {
@@ -258,20 +412,8 @@ private:
         return true;
     }
 
-    virtual Int32 _CountXPressoTagsDirty(BaseObject* op, DIRTYFLAGS flags=DIRTYFLAGS_ALL, HDIRTYFLAGS hflags=HDIRTYFLAGS_ALL) {
-        Int32 dcnt = 0;
-
-        // Iterate over all tags.
-        for (BaseTag* tag=op->GetFirstTag(); tag; tag=tag->GetNext()) {
-            // Filter XPresso Tags.
-            if (tag->IsInstanceOf(Texpresso)) {
-                dcnt += tag->GetDirty(flags) + tag->GetHDirty(hflags);
-                GvNodeMaster* master = static_cast<XPressoTag*>(tag)->GetNodeMaster();
-                if (master) dcnt += master->GetDirty(flags) + master->GetHDirty(hflags);;
-            }
-        }
-
-        return dcnt;
+    virtual Int32 _CountXPressoTagsDirty(BaseObject* op) {
+        return m_tags.GetDirty(op);
     }
 
     /**
@@ -280,6 +422,16 @@ private:
      */
     XPressoEffector_ExecInfo m_execInfo;
 
+    /**
+     * Storage for `m_execInfo.easyValues`, kept across evaluations.
+     */
+    maxon::BaseArray<Vector> m_easyValues;
+
+    /**
+     * The XPresso tags of the effector, used to compute their dirty-count.
+     */
+    XPressoTagTracker m_tags;
+
     /**
      * Keeps track of the dirty-count of all XPresso tags of the effector.
      */
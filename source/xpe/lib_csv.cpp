@@ -17,6 +17,8 @@
 #include "lib_csv.h"
 #include <cctype>  // isspace
 #include <cstdlib> // strtoll
+#include <locale>  // std::locale::classic
+#include <sstream> // std::istringstream
 
 #if defined(_MSC_VER)
     #define strtoll _strtoi64
@@ -222,4 +224,58 @@ Float StringToReal(const String& str) {
     return value;
 }
 
+Bool StringParseLong(const String& str, Int32* dest) {
+    Char* cstr = str.GetCStringCopy();
+    if (!cstr) {
+        return false;
+    }
+    Char* end = nullptr;
+    long long int value = strtoll(cstr, &end, 10);
+    Bool ok = end != cstr;
+    while (ok && *end) {
+        if (!IsSpace((UChar) *end++)) ok = false;
+    }
+    ok = ok && value >= LIMIT<Int32>::MIN && value <= LIMIT<Int32>::MAX;
+    DeleteMem(cstr);
+
+    if (ok && dest) *dest = (Int32) value;
+    return ok;
+}
+
+Bool StringParseReal(const String& str, Float* dest) {
+    Char* cstr = str.GetCStringCopy();
+    if (!cstr) {
+        return false;
+    }
+
+    // strtod() depends on the decimal separator of the C locale, but CSV
+    // files always use a dot. Parse with the classic locale instead.
+    std::istringstream stream(cstr);
+    stream.imbue(std::locale::classic());
+    double value = 0.0;
+    stream >> std::ws >> value;
+    Bool ok = !stream.fail();
+    for (int chr = stream.get(); ok && chr != EOF; chr = stream.get()) {
+        if (!IsSpace((UChar) chr)) ok = false;
+    }
+    DeleteMem(cstr);
+
+    if (ok && dest) *dest = value;
+    return ok;
+}
 
+std::string CSVFilenameToPath(const Filename& filename) {
+    Char* cstr = filename.GetString().GetCStringCopy(STRINGENCODING_UTF8);
+    if (!cstr) {
+        return std::string();
+    }
+    std::string path = cstr;
+    DeleteMem(cstr);
+    return path;
+}
+
+Filename CSVPathToFilename(const std::string& path) {
+    String str;
+    str.SetCString(path.c_str(), -1, STRINGENCODING_UTF8);
+    return Filename(str);
+}
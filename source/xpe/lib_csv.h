@@ -18,6 +18,8 @@
 #define NR_LIB_CSV_H
 
     #include <c4d_apibridge.h>
+    #include <string>
+    #include "csvcache.hpp"
 
     #if API_VERSION < 15000
         /* From R15.020 maxon/utilities/apibasemath.h */
@@ -274,6 +276,18 @@
          */
         Bool Loaded() const { return m_loaded; }
 
+        /**
+         * Returns the approximate number of bytes occupied by the table.
+         * Subclasses should add the memory of the data they store.
+         */
+        virtual Int GetMemoryUsage() const {
+            Int bytes = sizeof(*this);
+            for (Int32 i=0; i < m_header.GetCount(); i++) {
+                bytes += sizeof(String) + m_header[i].GetLength() * sizeof(Utf16Char);
+            }
+            return bytes;
+        }
+
     protected:
 
         /**
@@ -410,8 +424,27 @@
 
         virtual Int32 GetColumnCount() const { return m_columnCount; }
 
+        virtual Int GetMemoryUsage() const {
+            Int bytes = super::GetMemoryUsage();
+            for (Int32 i=0; i < m_rows.GetCount(); i++) {
+                const Array& row = m_rows[i];
+                bytes += sizeof(Array);
+                for (Int32 j=0; j < row.GetCount(); j++) {
+                    bytes += CSVCellMemory(row[j]);
+                }
+            }
+            return bytes;
+        }
+
     private:
 
+        static Int CSVCellMemory(const String& cell) {
+            return sizeof(String) + cell.GetLength() * sizeof(Utf16Char);
+        }
+
+        template <typename U>
+        static Int CSVCellMemory(const U& cell) { return sizeof(U); }
+
         Int32 m_columnCount;
         maxon::BaseArray<Array> m_rows;
 
@@ -450,6 +483,21 @@
      */
     Float StringToReal(const String& str);
 
+    /**
+     * Parse a String as an integer. Unlike #StringToLong(), this fails
+     * if the string contains anything but the number and surrounding
+     * whitespace. Returns true on success.
+     */
+    Bool StringParseLong(const String& str, Int32* dest);
+
+    /**
+     * Parse a String as a decimal number. Unlike #StringToReal(), this
+     * fails if the string contains anything but the number and surrounding
+     * whitespace, and always expects a dot as the decimal separator,
+     * independent of the locale. Returns true on success.
+     */
+    Bool StringParseReal(const String& str, Float* dest);
+
     /**
      * Returns a copy of the string.
      */
@@ -515,6 +563,10 @@
 
         //| BaseCSVTable Overrides
 
+        virtual Int GetMemoryUsage() const {
+            return super::GetMemoryUsage() + (m_minv.GetCount() + m_maxv.GetCount()) * sizeof(Float);
+        }
+
         virtual void FlushData() {
             m_minv.Reset();
             m_maxv.Reset();
@@ -552,4 +604,188 @@
 
     };
 
+    enum CSVColumnType {
+        CSVColumnType_String,   // At least one cell is not a number, or all cells are empty.
+        CSVColumnType_Int,      // All non-empty cells are integers.
+        CSVColumnType_Float,    // All non-empty cells are numbers, at least one is not an integer.
+    };
+
+    /**
+     * This String CSV Table subclass determines the type of every column
+     * and parses the cells of the numeric columns once when the table is
+     * loaded, so that consumers sharing the table do not need to parse
+     * them again.
+     */
+    class ColumnCSVTable : public StringCSVTable {
+
+        typedef StringCSVTable super;
+
+    public:
+
+        ColumnCSVTable(Char delimiter=',', Bool hasHeader=false)
+        : super(delimiter, hasHeader) { }
+
+        /**
+         * Returns the type of the specified column. Only valid if the
+         * table successfully initialized.
+         */
+        CSVColumnType GetColumnType(Int32 column) const {
+            if (column < 0 || column >= m_types.GetCount()) return CSVColumnType_String;
+            return m_types[column];
+        }
+
+        /**
+         * Returns the number in the specified cell. Cells of numeric
+         * columns are parsed when the table is loaded, other cells are
+         * parsed on demand. Returns zero if the cell is not a number.
+         */
+        Float GetNumber(Int32 rowIndex, Int32 column) const {
+            if (rowIndex < 0 || rowIndex >= GetRowCount() || column < 0) return 0.0;
+            if (GetColumnType(column) != CSVColumnType_String) {
+                return m_numbers[(Int) rowIndex * m_types.GetCount() + column];
+            }
+            const Array& row = GetRow(rowIndex);
+            Float value = 0.0;
+            if (column < row.GetCount()) StringParseReal(row[column], &value);
+            return value;
+        }
+
+        //| BaseCSVTable Overrides
+
+        virtual Int GetMemoryUsage() const {
+            return super::GetMemoryUsage() + m_types.GetCount() * sizeof(CSVColumnType)
+                + m_numbers.GetCount() * sizeof(Float);
+        }
+
+        virtual void FlushData() {
+            m_types.Reset();
+            m_numbers.Reset();
+            super::FlushData();
+        }
+
+        virtual void LoadDataEnd(CSVError error) {
+            super::LoadDataEnd(error);
+            if (error != CSVError_None) return;
+
+            Int32 colCount = GetColumnCount();
+            Int32 rowCount = GetRowCount();
+            iferr (m_types.Resize(colCount))
+                return;
+            iferr (m_numbers.Resize((Int) rowCount * colCount)) {
+                m_types.Reset();
+                return;
+            }
+
+            for (Int32 col=0; col < colCount; col++) {
+                Bool isInt = true, isFloat = true, empty = true;
+                for (Int32 rowIndex=0; rowIndex < rowCount && isFloat; rowIndex++) {
+                    const Array& row = GetRow(rowIndex);
+                    Float& dest = m_numbers[(Int) rowIndex * colCount + col];
+                    dest = 0.0;
+                    if (col >= row.GetCount() || c4d_apibridge::IsEmpty(row[col])) continue;
+                    empty = false;
+
+                    Int32 intValue;
+                    if (isInt && StringParseLong(row[col], &intValue)) {
+                        dest = intValue;
+                        continue;
+                    }
+                    isInt = false;
+                    isFloat = StringParseReal(row[col], &dest);
+                }
+
+                if (empty || !isFloat) m_types[col] = CSVColumnType_String;
+                else if (isInt) m_types[col] = CSVColumnType_Int;
+                else m_types[col] = CSVColumnType_Float;
+            }
+        }
+
+    private:
+
+        maxon::BaseArray<CSVColumnType> m_types;
+        maxon::BaseArray<Float> m_numbers;  // rows * columns, row-major
+
+    };
+
+    /**
+     * Convert a Filename to a UTF-8 encoded path and back, for use with
+     * the csvcache.
+     */
+    std::string CSVFilenameToPath(const Filename& filename);
+    Filename CSVPathToFilename(const std::string& path);
+
+    /**
+     * Holds a table of type *T* that is loaded through the process-wide
+     * csvcache and thus shared with all other consumers that load the
+     * same file with the same settings. The table can not be modified.
+     * Access it like a pointer, it is never null.
+     */
+    template <typename T>
+    class SharedCSVTable {
+
+    public:
+
+        /**
+         * The *kind* separates tables of different types in the cache
+         * and must be unique for *T*.
+         */
+        SharedCSVTable(const char* kind) : m_kind(kind), m_success(true) { }
+
+        /**
+         * Acquire the table for the specified file and settings from the
+         * cache. Behaves like `BaseCSVTable::Init()`, *didReload* is set
+         * to true if the table has been exchanged. If *forceUpdate* is
+         * true, the file is parsed again even if it is in the cache.
+         */
+        Bool Init(const Filename& filename, Char delimiter, Bool hasHeader,
+                  Bool forceUpdate=false, Bool* didReload=nullptr) {
+            if (didReload) *didReload = false;
+            csvcache::key key = csvcache::make_key(
+                m_kind, CSVFilenameToPath(filename), delimiter, hasHeader);
+            if (!forceUpdate && m_table && key == m_key) return m_success;
+
+            std::shared_ptr<const Entry> table = csvcache::acquire<Entry>(key, forceUpdate);
+            if (!table) return false;
+            if (didReload && table != m_table) *didReload = true;
+            m_table = table;
+            m_key = key;
+            m_success = table->success;
+            return m_success;
+        }
+
+        /**
+         * Release the table. The object behaves like an empty table
+         * until `Init()` is called again.
+         */
+        void Release() {
+            m_table.reset();
+        }
+
+        const T* operator -> () const { return m_table ? &m_table->data : &m_empty; }
+
+        const T& operator * () const { return *operator -> (); }
+
+    private:
+
+        struct Entry : public csvcache::table {
+            T data;
+            Bool success;
+
+            Entry(const csvcache::key& key) : data(key.delim, key.header) {
+                success = data.Init(CSVPathToFilename(key.path), true);
+            }
+
+            virtual size_t memory_usage() const {
+                return (size_t) data.GetMemoryUsage();
+            }
+        };
+
+        std::string m_kind;
+        csvcache::key m_key;
+        std::shared_ptr<const Entry> m_table;
+        Bool m_success;
+        T m_empty;
+
+    };
+
 #endif /* NR_LIB_CSV_H */